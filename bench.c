@@ -0,0 +1,146 @@
+/*
+
+   `bench.c` - Compares the compiled globs against the state table, run it with `make bench`
+
+   Every glob is compiled with and without `jit` and searched in the same generated text with ng_search_buffer(). The
+   match count and a hash of the offsets have to be the same for both, and the best of a few runs is printed in MB/s.
+   `bench [MB] [RUNS]` changes the size of the text or the number of runs. The library is measured as it's built, the
+   default CFLAGS don't optimize it so `make clean bench CFLAGS=-O2` gives numbers closer to a release build
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "notgrep.h"
+
+#define DEFAULT_MEGABYTES 64
+#define DEFAULT_RUNS 5
+
+// The last one has states with more than 8 targets, so the JIT emits jump tables for them
+const char *bench_globs[] = {
+    "[!a-z ][!a-z ]x",
+    "a*b*c*q",
+    "[xz]?[y0]9",
+    "abcab*x",
+    "ab*cd*ef*gh*ij*kl*mn*op*qr",
+};
+
+uint64_t rng_state = 0x62656e6368ull;
+
+uint64_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Lines of 20 to 120 bytes of lowercase words with a few digits
+char *generate_text(size_t size)
+{
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyzabcdefghijkl0123456789    ";
+    char *text = malloc(size);
+    if(text == NULL) {
+        fprintf(stderr, "ERROR: Couldn't allocate %zu bytes of text\n", size);
+        exit(EXIT_FAILURE);
+    }
+    size_t line_left = 0;
+    for(size_t i = 0; i < size; ++i) {
+        if(line_left == 0) {
+            text[i] = '\n';
+            line_left = 20 + rng_next() % 101;
+            continue;
+        }
+        text[i] = alphabet[rng_next() % (sizeof(alphabet) - 1)];
+        line_left -= 1;
+    }
+    return text;
+}
+
+typedef struct Result {
+    size_t count;
+    uint64_t hash;
+} Result;
+
+int hash_match(void *user, const ng_match_t *match)
+{
+    Result *result = user;
+    result->count += 1;
+    result->hash = (result->hash ^ match->offset) * 0x100000001b3ull;
+    result->hash = (result->hash ^ match->len) * 0x100000001b3ull;
+    return 0;
+}
+
+double now_seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+}
+
+// This function returns the best time of `runs` searches of `text` in seconds, `result` is set by the last one
+double bench_glob(const char *glob, int jit, const char *text, size_t size, int runs, Result *result)
+{
+    ng_pattern_options_t options = ng_pattern_default_options();
+    options.glob = 1;
+    options.jit = jit;
+    ng_pattern_t *pattern;
+    if(ng_pattern_compile(&pattern, glob, strlen(glob), &options) != NG_OK) {
+        fprintf(stderr, "ERROR: Couldn't compile \"%s\"\n", glob);
+        exit(EXIT_FAILURE);
+    }
+    ng_search_options_t search_options = ng_search_default_options();
+    search_options.thread_count = 1;
+    double best = 0.0;
+    for(int run = 0; run < runs; ++run) {
+        *result = (Result){ .hash = 0xcbf29ce484222325ull };
+        ng_searcher_t *searcher = ng_searcher_new(pattern, &search_options, hash_match, result);
+        if(searcher == NULL) {
+            fprintf(stderr, "ERROR: Couldn't create a searcher\n");
+            exit(EXIT_FAILURE);
+        }
+        // The matches are delivered when the searcher is freed, so that's part of the time
+        double start = now_seconds();
+        ng_search_buffer(searcher, "", text, size);
+        ng_searcher_free(searcher);
+        double elapsed = now_seconds() - start;
+        if(run == 0 || elapsed < best) best = elapsed;
+    }
+    ng_pattern_free(pattern);
+    return best;
+}
+
+int main(int argc, const char **argv)
+{
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : DEFAULT_MEGABYTES;
+    int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+    if(megabytes == 0) megabytes = DEFAULT_MEGABYTES;
+    if(runs <= 0) runs = DEFAULT_RUNS;
+
+    size_t size = megabytes*1024*1024;
+    char *text = generate_text(size);
+    size_t failures = 0;
+    printf("%-26s %12s %12s %10s\n", "glob", "table", "jit", "matches");
+    for(size_t i = 0; i < sizeof(bench_globs)/sizeof(bench_globs[0]); ++i) {
+        Result table, jit;
+        double table_seconds = bench_glob(bench_globs[i], 0, text, size, runs, &table);
+        double jit_seconds = bench_glob(bench_globs[i], 1, text, size, runs, &jit);
+        printf("%-26s %7.0f MB/s %7.0f MB/s %10zu\n", bench_globs[i],
+               (double)megabytes/table_seconds, (double)megabytes/jit_seconds, table.count);
+        if(table.count != jit.count || table.hash != jit.hash) {
+            failures += 1;
+            fprintf(stderr, "FAIL: \"%s\" has %zu matches with the table and %zu with the jit\n",
+                    bench_globs[i], table.count, jit.count);
+        }
+    }
+    free(text);
+
+    if(failures > 0) {
+        fprintf(stderr, "%zu globs have different matches\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -62,7 +62,6 @@ void btka_platform_unmap_memory(void *buf, btka_size_t bufsz);
 
 #endif // BTK_ARENA_H_
 
-#define BTK_ARENA_IMPLEMENTATION
 #ifdef BTK_ARENA_IMPLEMENTATION
 
 btk_arena_region_t *_btka_create_arena_region(btka_size_t capacity)
@@ -168,6 +167,24 @@ void btka_platform_unmap_memory(void *buf, btka_size_t bufsz)
     }
     VirtualFreeEx(GetCurrentProcess(),(LPVOID)buf, bufsz, MEM_RELEASE);
 }
+#else
+#include <sys/mman.h>
+void *btka_platform_map_memory(btka_size_t size_in_bytes)
+{
+    void *buf = mmap(NULL, size_in_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(buf == MAP_FAILED) {
+        return BTKA_NULL;
+    }
+    return buf;
+}
+
+void btka_platform_unmap_memory(void *buf, btka_size_t bufsz)
+{
+    if(buf == BTKA_NULL) {
+        return;
+    }
+    munmap(buf, bufsz);
+}
 #endif
 #endif // BTKA_NO_PLATFORM
 
@@ -1,7 +1,25 @@
 #include "btk_fsutil.h"
 #include <string.h>
+#ifdef _WIN32
 #include <windows.h>
 #include <Shlwapi.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#endif
 
 enum btkfs_error_codes {
     BTKFS_ERROR_NONE = 0,
@@ -13,6 +31,7 @@ enum btkfs_error_codes {
     BTKFS_ERROR_NOT_A_FILE = -6,
     BTKFS_ERROR_NOT_A_DIRECTORY = -7,
     BTKFS_ERROR_COULDNT_OPEN_DIR = -8,
+    BTKFS_ERROR_UNSUPPORTED = -9,
 };
 
 static const char *_error_code_explanation[] = {
@@ -25,6 +44,7 @@ static const char *_error_code_explanation[] = {
     "Not a file",
     "Not a directory",
     "Could not open directory",
+    "Unsupported on this platform",
 };
 
 const char *btkfs_explain(int error_code)
@@ -34,14 +54,6 @@ const char *btkfs_explain(int error_code)
     return _error_code_explanation[index];
 }
 
-int btkfs_getcwd(char *dstbuf, size_t dstbufsz)
-{
-    if((dstbuf == NULL && dstbufsz > 0) || (dstbuf != NULL && dstbufsz == 0))
-        return BTKFS_ERROR_INVALID_ARGUMENTS;
-    DWORD length = GetCurrentDirectory(dstbufsz, dstbuf);
-    return length;
-}
-
 int btkfs_path_join(char *dstbuf, size_t dstbufsz, const char *path_a, const char *path_b)
 {
     if(path_a == NULL || path_b == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
@@ -110,6 +122,22 @@ int btkfs_getbasename(char *dstbuf, size_t dstbufsz, const char *path)
     return basename_len;
 }
 
+char *btkfs_next_in_direntry(char *direntry)
+{
+    size_t i;
+    for(i = 0; direntry[i] != 0; ++i);
+    return direntry + i + 1;
+}
+
+#ifdef _WIN32
+int btkfs_getcwd(char *dstbuf, size_t dstbufsz)
+{
+    if((dstbuf == NULL && dstbufsz > 0) || (dstbuf != NULL && dstbufsz == 0))
+        return BTKFS_ERROR_INVALID_ARGUMENTS;
+    DWORD length = GetCurrentDirectory(dstbufsz, dstbuf);
+    return length;
+}
+
 int btkfs_getabspath(char *dstbuf, size_t dstbufsz, const char *path)
 {
     if(path == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
@@ -143,7 +171,7 @@ btkfs_bool btkfs_isabspath(const char *path)
     return PathIsRelative(path) ? BTKFS_FALSE : BTKFS_TRUE;
 }
 
-size_t btkfs_get_file_size(const char *filepath)
+btkfs_u64 btkfs_get_file_size(const char *filepath)
 {
     // TODO(bagasjs): Assertion for invalid argument filepath
     HANDLE file_handle = CreateFileA(
@@ -158,9 +186,231 @@ size_t btkfs_get_file_size(const char *filepath)
     if(file_handle == INVALID_HANDLE_VALUE) {
         return 0;
     }
-    DWORD file_size = GetFileSize(file_handle, NULL);
+    LARGE_INTEGER file_size;
+    BOOL ok = GetFileSizeEx(file_handle, &file_size);
     CloseHandle(file_handle);
-    return file_size;
+    if(!ok) return 0;
+    return (btkfs_u64)file_size.QuadPart;
+}
+
+int btkfs_map_file(btkfs_mapped_file_t *mf, const char *filepath)
+{
+    if(mf == NULL || filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    mf->data = NULL;
+    mf->size = 0;
+    mf->file_handle = NULL;
+    mf->mapping_handle = NULL;
+    HANDLE file_handle = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file_handle == INVALID_HANDLE_VALUE) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file_handle, &file_size)) {
+        CloseHandle(file_handle);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    if(file_size.QuadPart == 0) {
+        CloseHandle(file_handle);
+        return 0;
+    }
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping_handle == NULL) {
+        CloseHandle(file_handle);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    void *data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if(data == NULL) {
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    mf->data = data;
+    mf->size = (btkfs_u64)file_size.QuadPart;
+    mf->file_handle = file_handle;
+    mf->mapping_handle = mapping_handle;
+    return 0;
+}
+
+// The file handle belongs to the fd, only the mapping is closed with the file
+int btkfs_map_fd(btkfs_mapped_file_t *mf, int fd)
+{
+    if(mf == NULL || fd < 0) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    mf->data = NULL;
+    mf->size = 0;
+    mf->file_handle = NULL;
+    mf->mapping_handle = NULL;
+    HANDLE file_handle = (HANDLE)_get_osfhandle(fd);
+    if(file_handle == INVALID_HANDLE_VALUE) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file_handle, &file_size)) return BTKFS_ERROR_UNKNOWN;
+    if(file_size.QuadPart == 0) return 0;
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping_handle == NULL) return BTKFS_ERROR_UNKNOWN;
+    void *data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if(data == NULL) {
+        CloseHandle(mapping_handle);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    mf->data = data;
+    mf->size = (btkfs_u64)file_size.QuadPart;
+    mf->mapping_handle = mapping_handle;
+    return 0;
+}
+
+void btkfs_unmap_file(btkfs_mapped_file_t *mf)
+{
+    if(mf->data != NULL) UnmapViewOfFile(mf->data);
+    if(mf->mapping_handle != NULL) CloseHandle(mf->mapping_handle);
+    if(mf->file_handle != NULL) CloseHandle(mf->file_handle);
+    mf->data = NULL;
+    mf->size = 0;
+}
+
+int btkfs_open_file(const char *filepath)
+{
+    if(filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    int fd = _open(filepath, _O_RDONLY | _O_BINARY | _O_NOINHERIT);
+    return fd < 0 ? BTKFS_ERROR_PATH_NOT_EXISTS : fd;
+}
+
+long long btkfs_read_file(int fd, void *dstbuf, size_t dstbufsz)
+{
+    if(dstbufsz > 0x40000000) dstbufsz = 0x40000000;
+    int n = _read(fd, dstbuf, (unsigned int)dstbufsz);
+    return n < 0 ? BTKFS_ERROR_UNKNOWN : (long long)n;
+}
+
+void btkfs_close_file(int fd)
+{
+    _close(fd);
+}
+
+// There's no *at() family here, the callers fall back to the full paths
+int btkfs_open_dir(const char *path)
+{
+    (void)path;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+int btkfs_open_dir_at(int dirfd, const char *name)
+{
+    (void)dirfd;
+    (void)name;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+int btkfs_open_file_at(int dirfd, const char *name)
+{
+    (void)dirfd;
+    (void)name;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+btkfs_bool btkfs_isdir_at(int dirfd, const char *name)
+{
+    (void)dirfd;
+    (void)name;
+    return BTKFS_FALSE;
+}
+
+btkfs_u64 btkfs_get_fd_size(int fd)
+{
+    long long size = _filelengthi64(fd);
+    return size < 0 ? 0 : (btkfs_u64)size;
+}
+
+// There's no page cache advice for a file here, so nothing is prefetched nor dropped
+int btkfs_advise_fd(int fd, btkfs_advice_t advice)
+{
+    (void)fd;
+    (void)advice;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+int btkfs_advise_file(const char *filepath, btkfs_advice_t advice)
+{
+    (void)advice;
+    if(filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    return 0;
+}
+
+btkfs_bool btkfs_is_fd_cached(int fd, btkfs_u64 count)
+{
+    (void)fd;
+    (void)count;
+    return BTKFS_FALSE;
+}
+
+// The file ids aren't supported here, so nothing that's keyed by them (the result cache, the Bloom filters,
+// the suffix arrays, the line index sidecars and following a file) works on Windows
+int btkfs_get_file_id(btkfs_file_id_t *id, const char *filepath)
+{
+    (void)id;
+    (void)filepath;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+int btkfs_get_file_id_at(btkfs_file_id_t *id, int dirfd, const char *name)
+{
+    (void)id;
+    (void)dirfd;
+    (void)name;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+int btkfs_get_fd_id(btkfs_file_id_t *id, int fd)
+{
+    (void)id;
+    (void)fd;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+long long btkfs_read_file_at(int fd, void *dstbuf, size_t dstbufsz, btkfs_u64 offset)
+{
+    if(_lseeki64(fd, (__int64)offset, SEEK_SET) < 0) return BTKFS_ERROR_UNKNOWN;
+    return btkfs_read_file(fd, dstbuf, dstbufsz);
+}
+
+// Shared writable mappings aren't supported here
+int btkfs_map_shared_file(btkfs_shared_file_t *sf, const char *filepath, btkfs_u64 size)
+{
+    (void)filepath;
+    (void)size;
+    if(sf == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    sf->data = NULL;
+    sf->size = 0;
+    sf->fd = -1;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+void btkfs_unmap_shared_file(btkfs_shared_file_t *sf)
+{
+    (void)sf;
+}
+
+// Watching directories isn't supported here, btkfs_watch_wait() of a watch that couldn't be opened only sleeps
+int btkfs_watch_open(btkfs_watch_t *watch)
+{
+    if(watch == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    watch->fd = -1;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+int btkfs_watch_add(btkfs_watch_t *watch, const char *dirpath)
+{
+    if(watch == NULL || dirpath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    return BTKFS_ERROR_UNSUPPORTED;
+}
+
+void btkfs_watch_close(btkfs_watch_t *watch)
+{
+    (void)watch;
+}
+
+int btkfs_watch_wait(btkfs_watch_t *watch, int timeout_ms)
+{
+    (void)watch;
+    Sleep((DWORD)timeout_ms);
+    return 0;
 }
 
 #include <stdio.h>
@@ -214,10 +464,373 @@ int btkfs_readdir(char *dstbuf, size_t dstbufsz, const char *dirpath)
 
     return 0;
 }
+#else
+int btkfs_getcwd(char *dstbuf, size_t dstbufsz)
+{
+    if((dstbuf == NULL && dstbufsz > 0) || (dstbuf != NULL && dstbufsz == 0))
+        return BTKFS_ERROR_INVALID_ARGUMENTS;
+    char cwd[PATH_MAX];
+    if(getcwd(cwd, sizeof(cwd)) == NULL) return BTKFS_ERROR_UNKNOWN;
+    size_t length = strlen(cwd);
+    // Following GetCurrentDirectory, the required size (with null terminator) is returned if dstbuf is not enough
+    if(dstbuf == NULL || dstbufsz <= length) return (int)length + 1;
+    memcpy(dstbuf, cwd, length + 1);
+    return (int)length;
+}
+
+int btkfs_getabspath(char *dstbuf, size_t dstbufsz, const char *path)
+{
+    if(path == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    char abspath[PATH_MAX];
+    if(realpath(path, abspath) == NULL) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    size_t length = strlen(abspath);
+    if(dstbuf == NULL || dstbufsz <= length) return (int)length + 1;
+    memcpy(dstbuf, abspath, length + 1);
+    return 0;
+}
 
-char *btkfs_next_in_direntry(char *direntry)
+btkfs_bool btkfs_exists(const char *path)
 {
-    size_t i;
-    for(i = 0; direntry[i] != 0; ++i);
-    return direntry + i + 1;
+    struct stat st;
+    return stat(path, &st) == 0 ? BTKFS_TRUE : BTKFS_FALSE;
+}
+
+btkfs_bool btkfs_isdir(const char *path)
+{
+    struct stat st;
+    if(stat(path, &st) != 0) return BTKFS_FALSE;
+    return S_ISDIR(st.st_mode) ? BTKFS_TRUE : BTKFS_FALSE;
+}
+
+btkfs_bool btkfs_isabspath(const char *path)
+{
+    if(path == NULL) return BTKFS_FALSE;
+    return path[0] == BTKFS_PATHSEP ? BTKFS_TRUE : BTKFS_FALSE;
+}
+
+btkfs_u64 btkfs_get_file_size(const char *filepath)
+{
+    struct stat st;
+    if(stat(filepath, &st) != 0) return 0;
+    return (btkfs_u64)st.st_size;
+}
+
+int btkfs_map_file(btkfs_mapped_file_t *mf, const char *filepath)
+{
+    if(mf == NULL || filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    mf->data = NULL;
+    mf->size = 0;
+    int fd = open(filepath, O_RDONLY);
+    if(fd < 0) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    int res = btkfs_map_fd(mf, fd);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    return res;
+}
+
+int btkfs_map_fd(btkfs_mapped_file_t *mf, int fd)
+{
+    if(mf == NULL || fd < 0) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    mf->data = NULL;
+    mf->size = 0;
+    struct stat st;
+    if(fstat(fd, &st) != 0) return BTKFS_ERROR_UNKNOWN;
+    if(S_ISDIR(st.st_mode)) return BTKFS_ERROR_NOT_A_FILE;
+    if(st.st_size == 0) return 0;
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) return BTKFS_ERROR_UNKNOWN;
+    mf->data = data;
+    mf->size = (btkfs_u64)st.st_size;
+    return 0;
+}
+
+void btkfs_unmap_file(btkfs_mapped_file_t *mf)
+{
+    if(mf->data != NULL) munmap((void *)mf->data, (size_t)mf->size);
+    mf->data = NULL;
+    mf->size = 0;
+}
+
+// O_NOATIME is only allowed for the owner of the file. Once it's refused it's not tried anymore, so the
+// files of the other users don't cost two opens each
+static volatile int _btkfs_noatime_refused = 0;
+
+static int _btkfs_open_at(int dirfd, const char *name, int flags)
+{
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+#ifdef O_NOATIME
+    if(!_btkfs_noatime_refused) {
+        int fd = openat(dirfd, name, flags | O_NOATIME);
+        if(fd >= 0 || errno != EPERM) return fd < 0 ? BTKFS_ERROR_PATH_NOT_EXISTS : fd;
+        _btkfs_noatime_refused = 1;
+    }
+#endif
+    int fd = openat(dirfd, name, flags);
+    return fd < 0 ? BTKFS_ERROR_PATH_NOT_EXISTS : fd;
+}
+
+int btkfs_open_file(const char *filepath)
+{
+    if(filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    return _btkfs_open_at(AT_FDCWD, filepath, O_RDONLY);
+}
+
+int btkfs_open_file_at(int dirfd, const char *name)
+{
+    if(dirfd < 0 || name == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    return _btkfs_open_at(dirfd, name, O_RDONLY);
+}
+
+int btkfs_open_dir(const char *path)
+{
+    if(path == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    return _btkfs_open_at(AT_FDCWD, path, O_RDONLY | O_DIRECTORY);
+}
+
+int btkfs_open_dir_at(int dirfd, const char *name)
+{
+    if(dirfd < 0 || name == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    return _btkfs_open_at(dirfd, name, O_RDONLY | O_DIRECTORY);
+}
+
+btkfs_bool btkfs_isdir_at(int dirfd, const char *name)
+{
+    struct stat st;
+    if(dirfd < 0 || name == NULL || fstatat(dirfd, name, &st, 0) != 0) return BTKFS_FALSE;
+    return S_ISDIR(st.st_mode) ? BTKFS_TRUE : BTKFS_FALSE;
+}
+
+btkfs_u64 btkfs_get_fd_size(int fd)
+{
+    struct stat st;
+    if(fstat(fd, &st) != 0) return 0;
+    return (btkfs_u64)st.st_size;
+}
+
+long long btkfs_read_file(int fd, void *dstbuf, size_t dstbufsz)
+{
+    ssize_t n;
+    do {
+        n = read(fd, dstbuf, dstbufsz);
+    } while(n < 0 && errno == EINTR);
+    return n < 0 ? BTKFS_ERROR_UNKNOWN : (long long)n;
+}
+
+void btkfs_close_file(int fd)
+{
+    close(fd);
+}
+
+int btkfs_advise_fd(int fd, btkfs_advice_t advice)
+{
+#ifdef POSIX_FADV_WILLNEED
+    int res = posix_fadvise(fd, 0, 0, advice == BTKFS_ADVICE_WILLNEED ? POSIX_FADV_WILLNEED : POSIX_FADV_DONTNEED);
+    return res == 0 ? 0 : BTKFS_ERROR_UNKNOWN;
+#else
+    (void)fd;
+    (void)advice;
+    return 0;
+#endif
+}
+
+int btkfs_advise_file(const char *filepath, btkfs_advice_t advice)
+{
+    if(filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    int fd = btkfs_open_file(filepath);
+    if(fd < 0) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    int res = btkfs_advise_fd(fd, advice);
+    close(fd);
+    return res;
+}
+
+btkfs_bool btkfs_is_fd_cached(int fd, btkfs_u64 count)
+{
+    if(fd < 0 || count == 0) return BTKFS_FALSE;
+    void *data = mmap(NULL, (size_t)count, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) return BTKFS_FALSE;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t page_count = ((size_t)count + page_size - 1)/page_size;
+    unsigned char pages[64];
+    if(page_count > sizeof(pages)) page_count = sizeof(pages);
+    btkfs_bool cached = mincore(data, page_count*page_size, (void *)pages) == 0;
+    for(size_t i = 0; cached && i < page_count; ++i) cached = (pages[i] & 1) != 0;
+    munmap(data, (size_t)count);
+    return cached;
+}
+
+static void _btkfs_file_id_from_stat(btkfs_file_id_t *id, const struct stat *st)
+{
+    id->device = (btkfs_u64)st->st_dev;
+    id->inode = (btkfs_u64)st->st_ino;
+    id->size = (btkfs_u64)st->st_size;
+#if defined(__APPLE__)
+    id->mtime_ns = (btkfs_u64)st->st_mtimespec.tv_sec*1000000000ull + (btkfs_u64)st->st_mtimespec.tv_nsec;
+#else
+    id->mtime_ns = (btkfs_u64)st->st_mtim.tv_sec*1000000000ull + (btkfs_u64)st->st_mtim.tv_nsec;
+#endif
+}
+
+int btkfs_get_file_id(btkfs_file_id_t *id, const char *filepath)
+{
+    struct stat st;
+    if(id == NULL || filepath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    if(stat(filepath, &st) != 0) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    if(!S_ISREG(st.st_mode)) return BTKFS_ERROR_NOT_A_FILE;
+    _btkfs_file_id_from_stat(id, &st);
+    return 0;
+}
+
+int btkfs_get_file_id_at(btkfs_file_id_t *id, int dirfd, const char *name)
+{
+    struct stat st;
+    if(id == NULL || dirfd < 0 || name == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    if(fstatat(dirfd, name, &st, 0) != 0) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    if(!S_ISREG(st.st_mode)) return BTKFS_ERROR_NOT_A_FILE;
+    _btkfs_file_id_from_stat(id, &st);
+    return 0;
+}
+
+long long btkfs_read_file_at(int fd, void *dstbuf, size_t dstbufsz, btkfs_u64 offset)
+{
+    ssize_t n;
+    do {
+        n = pread(fd, dstbuf, dstbufsz, (off_t)offset);
+    } while(n < 0 && errno == EINTR);
+    return n < 0 ? BTKFS_ERROR_UNKNOWN : (long long)n;
+}
+
+int btkfs_get_fd_id(btkfs_file_id_t *id, int fd)
+{
+    struct stat st;
+    if(id == NULL || fd < 0) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    if(fstat(fd, &st) != 0) return BTKFS_ERROR_UNKNOWN;
+    if(!S_ISREG(st.st_mode)) return BTKFS_ERROR_NOT_A_FILE;
+    _btkfs_file_id_from_stat(id, &st);
+    return 0;
+}
+
+int btkfs_map_shared_file(btkfs_shared_file_t *sf, const char *filepath, btkfs_u64 size)
+{
+    if(sf == NULL || filepath == NULL || size == 0) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    sf->data = NULL;
+    sf->size = 0;
+    sf->fd = -1;
+    int flags = O_RDWR | O_CREAT;
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+    int fd = open(filepath, flags, 0644);
+    if(fd < 0) return BTKFS_ERROR_PATH_NOT_EXISTS;
+    // Two processes writing to the same mapping would corrupt it
+    if(flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (S_ISREG(st.st_mode) && (btkfs_u64)st.st_size != size && ftruncate(fd, (off_t)size) != 0)) {
+        close(fd);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    void *data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(data == MAP_FAILED) {
+        close(fd);
+        return BTKFS_ERROR_UNKNOWN;
+    }
+    // Unlike btkfs_map_file() the file is kept open, the lock goes away with it
+    sf->data = data;
+    sf->size = size;
+    sf->fd = fd;
+    return 0;
+}
+
+void btkfs_unmap_shared_file(btkfs_shared_file_t *sf)
+{
+    if(sf->data != NULL) munmap(sf->data, (size_t)sf->size);
+    if(sf->fd >= 0) close(sf->fd);
+    sf->data = NULL;
+    sf->size = 0;
+    sf->fd = -1;
+}
+
+int btkfs_watch_open(btkfs_watch_t *watch)
+{
+    if(watch == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    watch->fd = -1;
+#ifdef __linux__
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watch->fd < 0) return BTKFS_ERROR_UNKNOWN;
+#endif
+    return 0;
+}
+
+int btkfs_watch_add(btkfs_watch_t *watch, const char *dirpath)
+{
+    if(watch == NULL || dirpath == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+#ifdef __linux__
+    // A directory is watched instead of the file, so a file that's rotated or not created yet is still seen
+    uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+    if(watch->fd >= 0 && inotify_add_watch(watch->fd, dirpath, mask) < 0) return BTKFS_ERROR_COULDNT_OPEN_DIR;
+#endif
+    return 0;
+}
+
+void btkfs_watch_close(btkfs_watch_t *watch)
+{
+    if(watch->fd >= 0) close(watch->fd);
+    watch->fd = -1;
+}
+
+int btkfs_watch_wait(btkfs_watch_t *watch, int timeout_ms)
+{
+    if(watch == NULL) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    if(watch->fd < 0) {
+        poll(NULL, 0, timeout_ms);
+        return 0;
+    }
+    struct pollfd pfd = { .fd = watch->fd, .events = POLLIN };
+    int res = poll(&pfd, 1, timeout_ms);
+    if(res < 0) return errno == EINTR ? 0 : BTKFS_ERROR_UNKNOWN;
+    if(res == 0) return 0;
+    // Only that something happened matters, so every event that's queued is dropped
+    char events[4096];
+    while(read(watch->fd, events, sizeof(events)) > 0) {}
+    return 1;
+}
+
+int btkfs_readdir(char *dstbuf, size_t dstbufsz, const char *dirpath)
+{
+    if(!dirpath) return BTKFS_ERROR_INVALID_ARGUMENTS;
+    DIR *dp = opendir(dirpath);
+    if(dp == NULL) return BTKFS_ERROR_COULDNT_OPEN_DIR;
+
+    struct dirent *ep;
+    size_t total_length = 0;
+    while((ep = readdir(dp)) != NULL) {
+        if(strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) continue;
+        total_length += strlen(ep->d_name) + 1;
+    }
+    if(dstbuf == NULL || dstbufsz == 0 || dstbufsz < total_length + 1) {
+        closedir(dp);
+        return total_length+1;
+    }
+
+    // The end of the buffer would be 2 zeros
+    dstbuf[dstbufsz - 1] = 0;
+
+    rewinddir(dp);
+    size_t offset = 0;
+    while((ep = readdir(dp)) != NULL && offset < total_length) {
+        if(strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) continue;
+        size_t name_length = strlen(ep->d_name);
+        if(offset + name_length + 1 > total_length) break;
+        memcpy(dstbuf + offset, ep->d_name, name_length);
+        offset += name_length;
+        dstbuf[offset++] = 0;
+    }
+    closedir(dp);
+
+    return 0;
 }
+#endif // _WIN32
@@ -23,6 +23,7 @@
 #define BTKFS_FALSE 0
 #define BTKFS_TRUE 1
 typedef char btkfs_bool;
+typedef unsigned long long btkfs_u64;
 
 /**
  * This function gives you the current working directory
@@ -95,11 +96,192 @@ btkfs_bool btkfs_isdir(const char *path);
 btkfs_bool btkfs_exists(const char *path);
 
 /**
- * This function gets you the size of a file
+ * This function gets you the size of a file. It's 64 bit even on 32 bit platforms
+ * so files bigger than 4 GiB are reported correctly
  */
-size_t btkfs_get_file_size(const char *filepath);
+btkfs_u64 btkfs_get_file_size(const char *filepath);
 
 
+/**
+ * A read only memory mapping of an entire file
+ */
+typedef struct btkfs_mapped_file {
+    const char *data;
+    btkfs_u64 size;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+} btkfs_mapped_file_t;
+
+/**
+ * Map the whole file into memory as read only. Empty file is mapped with data == NULL
+ *
+ * This function returns int which
+ * btkfs_map_file(...) <  0 if it's an error
+ * btkfs_map_file(...) == 0 if it's success
+ */
+int btkfs_map_file(btkfs_mapped_file_t *mf, const char *filepath);
+void btkfs_unmap_file(btkfs_mapped_file_t *mf);
+
+/**
+ * Same as btkfs_map_file() but of a file that's already open, the fd stays open and could be closed before the
+ * mapping is unmapped
+ */
+int btkfs_map_fd(btkfs_mapped_file_t *mf, int fd);
+
+/**
+ * Open a file for reading only. The access time isn't updated when it's allowed and the file isn't inherited
+ * by the child processes. It's meant for reading small files with a single btkfs_read_file() without stdio
+ *
+ * This function returns int which
+ * btkfs_open_file(...) <  0 if it's an error
+ * btkfs_open_file(...) >= 0 if it's success and it's the file descriptor
+ */
+int btkfs_open_file(const char *filepath);
+
+/**
+ * Read at most `dstbufsz` bytes of an opened file, it's retried when it's interrupted by a signal
+ *
+ * This function returns long long which
+ * btkfs_read_file(...) <  0 if it's an error
+ * btkfs_read_file(...) == 0 if it's the end of the file
+ * btkfs_read_file(...) >  0 if it's success and it's the number of bytes read
+ */
+long long btkfs_read_file(int fd, void *dstbuf, size_t dstbufsz);
+void btkfs_close_file(int fd);
+
+/**
+ * Open a directory so its entries could be opened relative to it with the btkfs_xxx_at() functions without
+ * their full paths. It's closed with btkfs_close_file(). There's no *at() functions on Windows, it's always
+ * an error there and the entries should be opened by their full paths
+ *
+ * This function returns int which
+ * btkfs_open_dir(...) <  0 if it's an error
+ * btkfs_open_dir(...) >= 0 if it's success and it's the file descriptor of the directory
+ */
+int btkfs_open_dir(const char *path);
+int btkfs_open_dir_at(int dirfd, const char *name);
+
+/**
+ * Same as btkfs_open_file() but `name` is relative to a directory opened with btkfs_open_dir()
+ */
+int btkfs_open_file_at(int dirfd, const char *name);
+
+/**
+ * This function check if an entry of a directory opened with btkfs_open_dir() is a directory, a symlink is
+ * followed
+ */
+btkfs_bool btkfs_isdir_at(int dirfd, const char *name);
+
+/**
+ * This function gets you the size of an opened file
+ */
+btkfs_u64 btkfs_get_fd_size(int fd);
+
+typedef enum btkfs_advice {
+    BTKFS_ADVICE_WILLNEED = 0, // Start reading the file into the page cache in the background
+    BTKFS_ADVICE_DONTNEED,     // Drop the file from the page cache
+} btkfs_advice_t;
+
+/**
+ * Tell the OS how the content of a file is going to be used. It does nothing on the platforms
+ * without posix_fadvise
+ *
+ * This function returns int which
+ * btkfs_advise_file(...) <  0 if it's an error
+ * btkfs_advise_file(...) == 0 if it's success
+ */
+int btkfs_advise_file(const char *filepath, btkfs_advice_t advice);
+int btkfs_advise_fd(int fd, btkfs_advice_t advice);
+
+/**
+ * This function check if the first `count` bytes of an opened file are already in the page cache.
+ * It's always false on the platforms without mincore
+ */
+btkfs_bool btkfs_is_fd_cached(int fd, btkfs_u64 count);
+
+/**
+ * What tells a file apart from the other files and from its older contents, without reading it
+ */
+typedef struct btkfs_file_id {
+    btkfs_u64 device;
+    btkfs_u64 inode;
+    btkfs_u64 size;
+    btkfs_u64 mtime_ns; // Last modification time in nanoseconds
+} btkfs_file_id_t;
+
+/**
+ * Get the id of a file by its path or by its name inside a directory opened with btkfs_open_dir(), a symlink is
+ * followed. Anything but a regular file is an error, the content of a pipe or a device isn't known by its size
+ * and time. There's no inode on Windows, it's always an error there
+ *
+ * This function returns int which
+ * btkfs_get_file_id(...) <  0 if it's an error
+ * btkfs_get_file_id(...) == 0 if it's success
+ */
+int btkfs_get_file_id(btkfs_file_id_t *id, const char *filepath);
+int btkfs_get_file_id_at(btkfs_file_id_t *id, int dirfd, const char *name);
+int btkfs_get_fd_id(btkfs_file_id_t *id, int fd);
+
+/**
+ * Read at most `dstbufsz` bytes of an opened file starting from `offset` without moving its position
+ *
+ * This function returns long long which
+ * btkfs_read_file_at(...) <  0 if it's an error
+ * btkfs_read_file_at(...) >= 0 if it's success and it's the number of bytes read
+ */
+long long btkfs_read_file_at(int fd, void *dstbuf, size_t dstbufsz, btkfs_u64 offset);
+
+/**
+ * A writable memory mapping of a whole file, changes to it are written back to the file by the OS
+ */
+typedef struct btkfs_shared_file {
+    char *data;
+    btkfs_u64 size;
+    int fd;
+} btkfs_shared_file_t;
+
+/**
+ * Map a file as writable, it's created if it doesn't exist and resized to `size` if it's not that big. The file is
+ * locked, so it's an error if another process has it mapped already. It's only implemented on POSIX for now
+ *
+ * This function returns int which
+ * btkfs_map_shared_file(...) <  0 if it's an error
+ * btkfs_map_shared_file(...) == 0 if it's success
+ */
+int btkfs_map_shared_file(btkfs_shared_file_t *sf, const char *filepath, btkfs_u64 size);
+void btkfs_unmap_shared_file(btkfs_shared_file_t *sf);
+
+/**
+ * Wakes up when the files of the watched directories are written, created or moved into them. It's inotify on Linux,
+ * on the other POSIX systems there's nothing to wait for so btkfs_watch_wait() only sleeps for the timeout. On Windows
+ * btkfs_watch_open() fails with BTKFS_ERROR_UNSUPPORTED and btkfs_watch_wait() only sleeps as well
+ */
+typedef struct btkfs_watch {
+    int fd; // -1 if there's no inotify
+} btkfs_watch_t;
+
+/**
+ * These functions return int which
+ * btkfs_watch_xxx(...) <  0 if it's an error
+ * btkfs_watch_xxx(...) == 0 if it's success
+ */
+int btkfs_watch_open(btkfs_watch_t *watch);
+int btkfs_watch_add(btkfs_watch_t *watch, const char *dirpath);
+void btkfs_watch_close(btkfs_watch_t *watch);
+
+/**
+ * Wait until something happens in the watched directories or `timeout_ms` passes. The events that came meanwhile
+ * are taken as one
+ *
+ * This function returns int which
+ * btkfs_watch_wait(...) <  0 if it's an error
+ * btkfs_watch_wait(...) == 0 if it's the timeout
+ * btkfs_watch_wait(...) >  0 if something happened
+ */
+int btkfs_watch_wait(btkfs_watch_t *watch, int timeout_ms);
+
 /**
  * Read the entire entries of a directory and put it into a big 
  * chunk of char arrays containing the name of files/dirs in that
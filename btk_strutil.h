@@ -1,7 +1,29 @@
+/*
+
+   `btk_strutil.h` - A single header string view utilities with no memory allocation
+
+   GUIDE:
+   1. Create the implementation
+   ```c
+    #define BTK_STRUTIL_IMPLEMENTATION
+    #include "btk_strutil.h"
+   ```
+
+   2. The searching functions (`btk_sv_find_byte`, `btk_sv_rfind_byte`, `btk_sv_find`,
+      `btk_sv_count_byte`) will use SSE2 when it's available and falling back to plain loop
+      otherwise. Define BTKSU_NO_SIMD to force the plain loop.
+
+*/
 #ifndef BTK_STRUTIL_H_
 #define BTK_STRUTIL_H_
 
-typedef unsigned int btksu_size_t;
+#include <stddef.h>
+#include <stdint.h>
+
+typedef size_t btksu_size_t;
+
+// Returned by the searching functions when nothing is found
+#define BTK_SV_NPOS ((btksu_size_t)-1)
 
 typedef struct btk_stringview {
     const char *data;
@@ -13,11 +35,90 @@ typedef struct btk_stringview {
 #define BTK_SV_ARGV(sv) (int)(sv).count, (sv).data
 
 btk_stringview_t btk_sv_from_cstr(const char *);
+btk_stringview_t btk_sv_from_parts(const char *data, btksu_size_t count);
+
+/**
+ * Slice a string view from `start` until `end` (exclusive). Both are clamped into the view
+ */
+btk_stringview_t btk_sv_slice(btk_stringview_t sv, btksu_size_t start, btksu_size_t end);
+
+/**
+ * Check if both string views have the same content
+ */
+int btk_sv_eq(btk_stringview_t a, btk_stringview_t b);
+
+/**
+ * Find the index of the first `byte` inside `haystack`
+ * btk_sv_find_byte(...) == BTK_SV_NPOS if it's not found
+ */
+btksu_size_t btk_sv_find_byte(btk_stringview_t haystack, char byte);
+
+/**
+ * Find the index of the last `byte` inside `haystack`
+ * btk_sv_rfind_byte(...) == BTK_SV_NPOS if it's not found
+ */
+btksu_size_t btk_sv_rfind_byte(btk_stringview_t haystack, char byte);
+
+/**
+ * Find the index of the first occurence of `needle` inside `haystack`
+ * btk_sv_find(...) == BTK_SV_NPOS if it's not found
+ */
+btksu_size_t btk_sv_find(btk_stringview_t haystack, btk_stringview_t needle);
+
+/**
+ * Count how many `byte` are there inside `haystack`. Mostly used for counting lines
+ */
+btksu_size_t btk_sv_count_byte(btk_stringview_t haystack, char byte);
+
+/**
+ * Line iterator over a string view. The yielded line doesn't contain the '\n'
+ * i.e.
+ * ```c
+ *  btk_line_iter_t it = btk_line_iter_init(text);
+ *  btk_stringview_t line;
+ *  while(btk_line_iter_next(&it, &line)) {
+ *      // it.row is the row of `line`, it.line_offset is where `line` starts
+ *  }
+ * ```
+ */
+typedef struct btk_line_iter {
+    btk_stringview_t source;
+    btksu_size_t cursor;
+    btksu_size_t line_offset;
+    uint64_t row;
+} btk_line_iter_t;
+
+btk_line_iter_t btk_line_iter_init(btk_stringview_t source);
+int btk_line_iter_next(btk_line_iter_t *it, btk_stringview_t *line);
 
 #endif // BTK_STRUTIL_H_
 
 #ifdef BTK_STRUTIL_IMPLEMENTATION
 
+#if !defined(BTKSU_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#define BTKSU_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline unsigned int btksu__ctz(unsigned int x)
+{
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (unsigned int)index;
+}
+static inline unsigned int btksu__clz(unsigned int x)
+{
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return 31 - (unsigned int)index;
+}
+#else
+#define btksu__ctz(x) ((unsigned int)__builtin_ctz(x))
+#define btksu__clz(x) ((unsigned int)__builtin_clz(x))
+#endif
+
 btk_stringview_t btk_sv_from_cstr(const char *cstr)
 {
     btk_stringview_t result;
@@ -27,4 +128,152 @@ btk_stringview_t btk_sv_from_cstr(const char *cstr)
     return result;
 }
 
+btk_stringview_t btk_sv_from_parts(const char *data, btksu_size_t count)
+{
+    btk_stringview_t result;
+    result.data = data;
+    result.count = count;
+    return result;
+}
+
+btk_stringview_t btk_sv_slice(btk_stringview_t sv, btksu_size_t start, btksu_size_t end)
+{
+    if(end > sv.count) end = sv.count;
+    if(start > end) start = end;
+    return btk_sv_from_parts(sv.data + start, end - start);
+}
+
+static inline int btksu__memeq(const char *a, const char *b, btksu_size_t n)
+{
+    for(btksu_size_t i = 0; i < n; ++i) {
+        if(a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+int btk_sv_eq(btk_stringview_t a, btk_stringview_t b)
+{
+    return a.count == b.count && btksu__memeq(a.data, b.data, a.count);
+}
+
+btksu_size_t btk_sv_find_byte(btk_stringview_t haystack, char byte)
+{
+    const char *h = haystack.data;
+    btksu_size_t n = haystack.count;
+    btksu_size_t i = 0;
+#ifdef BTKSU_SSE2
+    const __m128i needle = _mm_set1_epi8(byte);
+    for(; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(h + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if(mask != 0) return i + btksu__ctz(mask);
+    }
 #endif
+    for(; i < n; ++i) {
+        if(h[i] == byte) return i;
+    }
+    return BTK_SV_NPOS;
+}
+
+btksu_size_t btk_sv_rfind_byte(btk_stringview_t haystack, char byte)
+{
+    const char *h = haystack.data;
+    btksu_size_t i = haystack.count;
+#ifdef BTKSU_SSE2
+    const __m128i needle = _mm_set1_epi8(byte);
+    for(; i >= 16; i -= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(h + i - 16));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if(mask != 0) return i - 16 + (31 - btksu__clz(mask));
+    }
+#endif
+    for(; i > 0; --i) {
+        if(h[i - 1] == byte) return i - 1;
+    }
+    return BTK_SV_NPOS;
+}
+
+btksu_size_t btk_sv_find(btk_stringview_t haystack, btk_stringview_t needle)
+{
+    if(needle.count == 0) return 0;
+    if(needle.count > haystack.count) return BTK_SV_NPOS;
+    if(needle.count == 1) return btk_sv_find_byte(haystack, needle.data[0]);
+
+    const char *h = haystack.data;
+    const char *p = needle.data;
+    btksu_size_t m = needle.count;
+    btksu_size_t last = haystack.count - m; // last valid start index
+    btksu_size_t i = 0;
+#ifdef BTKSU_SSE2
+    // Filter the candidates by comparing the first and the last byte of the needle at once, then
+    // only verify the middle part for the candidates
+    const __m128i first = _mm_set1_epi8(p[0]);
+    const __m128i final = _mm_set1_epi8(p[m - 1]);
+    for(; i + 16 <= last + 1; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(h + i));
+        __m128i block_final = _mm_loadu_si128((const __m128i *)(h + i + m - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_final, final));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+        while(mask != 0) {
+            unsigned int bit = btksu__ctz(mask);
+            if(btksu__memeq(h + i + bit + 1, p + 1, m - 2)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for(; i <= last; ++i) {
+        if(h[i] == p[0] && h[i + m - 1] == p[m - 1] && btksu__memeq(h + i + 1, p + 1, m - 2)) return i;
+    }
+    return BTK_SV_NPOS;
+}
+
+btksu_size_t btk_sv_count_byte(btk_stringview_t haystack, char byte)
+{
+    const char *h = haystack.data;
+    btksu_size_t n = haystack.count;
+    btksu_size_t i = 0;
+    btksu_size_t result = 0;
+#ifdef BTKSU_SSE2
+    const __m128i needle = _mm_set1_epi8(byte);
+    const __m128i zero = _mm_setzero_si128();
+    while(i + 16 <= n) {
+        // Every matching byte subtracts 1 (0xFF) from the byte counters, flush them before they overflow
+        __m128i counters = _mm_setzero_si128();
+        for(int round = 0; round < 255 && i + 16 <= n; ++round, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(h + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(block, needle));
+        }
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        result += (btksu_size_t)_mm_cvtsi128_si32(sums) + (btksu_size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+#endif
+    for(; i < n; ++i) {
+        if(h[i] == byte) result += 1;
+    }
+    return result;
+}
+
+btk_line_iter_t btk_line_iter_init(btk_stringview_t source)
+{
+    btk_line_iter_t it;
+    it.source = source;
+    it.cursor = 0;
+    it.line_offset = 0;
+    it.row = 0;
+    return it;
+}
+
+int btk_line_iter_next(btk_line_iter_t *it, btk_stringview_t *line)
+{
+    if(it->cursor >= it->source.count) return 0;
+    if(it->cursor != 0) it->row += 1;
+    btk_stringview_t rest = btk_sv_slice(it->source, it->cursor, it->source.count);
+    btksu_size_t newline = btk_sv_find_byte(rest, '\n');
+    btksu_size_t length = newline == BTK_SV_NPOS ? rest.count : newline;
+    *line = btk_sv_from_parts(rest.data, length);
+    it->line_offset = it->cursor;
+    it->cursor += newline == BTK_SV_NPOS ? rest.count : newline + 1;
+    return 1;
+}
+
+#endif // BTK_STRUTIL_IMPLEMENTATION
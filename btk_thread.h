@@ -0,0 +1,164 @@
+/*
+
+   `btk_thread.h` - A single header multiplatform (Linux and Windows) threading primitives
+
+   GUIDE:
+   1. Create the implementation
+   ```c
+    #define BTK_THREAD_IMPLEMENTATION
+    #include "btk_thread.h"
+   ```
+
+   2. Link with -lpthread on Linux
+
+*/
+#ifndef BTK_THREAD_H_
+#define BTK_THREAD_H_
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+typedef void (*btk_thread_fn)(void *arg);
+
+typedef struct btk_thread {
+    btk_thread_fn fn;
+    void *arg;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} btk_thread_t;
+
+typedef struct btk_mutex {
+#ifdef _WIN32
+    SRWLOCK handle;
+#else
+    pthread_mutex_t handle;
+#endif
+} btk_mutex_t;
+
+typedef struct btk_cond {
+#ifdef _WIN32
+    CONDITION_VARIABLE handle;
+#else
+    pthread_cond_t handle;
+#endif
+} btk_cond_t;
+
+/**
+ * Start running `fn(arg)` in a new thread. The `t` must stay alive until `btk_thread_join`
+ *
+ * This function returns int which
+ * btk_thread_create(...) == 0 if it's success
+ * btk_thread_create(...) != 0 if it's an error
+ */
+int btk_thread_create(btk_thread_t *t, btk_thread_fn fn, void *arg);
+void btk_thread_join(btk_thread_t *t);
+
+/**
+ * How many threads the machine could run at the same time. Always returns at least 1
+ */
+int btk_thread_hardware_concurrency(void);
+
+void btk_mutex_init(btk_mutex_t *m);
+void btk_mutex_destroy(btk_mutex_t *m);
+void btk_mutex_lock(btk_mutex_t *m);
+void btk_mutex_unlock(btk_mutex_t *m);
+
+void btk_cond_init(btk_cond_t *c);
+void btk_cond_destroy(btk_cond_t *c);
+void btk_cond_wait(btk_cond_t *c, btk_mutex_t *m);
+void btk_cond_signal(btk_cond_t *c);
+void btk_cond_broadcast(btk_cond_t *c);
+
+#endif // BTK_THREAD_H_
+
+#ifdef BTK_THREAD_IMPLEMENTATION
+
+#ifdef _WIN32
+static DWORD WINAPI btkth__trampoline(LPVOID param)
+{
+    btk_thread_t *t = (btk_thread_t *)param;
+    t->fn(t->arg);
+    return 0;
+}
+
+int btk_thread_create(btk_thread_t *t, btk_thread_fn fn, void *arg)
+{
+    t->fn = fn;
+    t->arg = arg;
+    t->handle = CreateThread(NULL, 0, btkth__trampoline, t, 0, NULL);
+    return t->handle == NULL ? -1 : 0;
+}
+
+void btk_thread_join(btk_thread_t *t)
+{
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+}
+
+int btk_thread_hardware_concurrency(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+void btk_mutex_init(btk_mutex_t *m) { InitializeSRWLock(&m->handle); }
+void btk_mutex_destroy(btk_mutex_t *m) { (void)m; }
+void btk_mutex_lock(btk_mutex_t *m) { AcquireSRWLockExclusive(&m->handle); }
+void btk_mutex_unlock(btk_mutex_t *m) { ReleaseSRWLockExclusive(&m->handle); }
+
+void btk_cond_init(btk_cond_t *c) { InitializeConditionVariable(&c->handle); }
+void btk_cond_destroy(btk_cond_t *c) { (void)c; }
+void btk_cond_wait(btk_cond_t *c, btk_mutex_t *m) { SleepConditionVariableSRW(&c->handle, &m->handle, INFINITE, 0); }
+void btk_cond_signal(btk_cond_t *c) { WakeConditionVariable(&c->handle); }
+void btk_cond_broadcast(btk_cond_t *c) { WakeAllConditionVariable(&c->handle); }
+#else
+#include <unistd.h>
+
+static void *btkth__trampoline(void *param)
+{
+    btk_thread_t *t = (btk_thread_t *)param;
+    t->fn(t->arg);
+    return NULL;
+}
+
+int btk_thread_create(btk_thread_t *t, btk_thread_fn fn, void *arg)
+{
+    t->fn = fn;
+    t->arg = arg;
+    return pthread_create(&t->handle, NULL, btkth__trampoline, t);
+}
+
+void btk_thread_join(btk_thread_t *t)
+{
+    pthread_join(t->handle, NULL);
+}
+
+int btk_thread_hardware_concurrency(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+void btk_mutex_init(btk_mutex_t *m) { pthread_mutex_init(&m->handle, NULL); }
+void btk_mutex_destroy(btk_mutex_t *m) { pthread_mutex_destroy(&m->handle); }
+void btk_mutex_lock(btk_mutex_t *m) { pthread_mutex_lock(&m->handle); }
+void btk_mutex_unlock(btk_mutex_t *m) { pthread_mutex_unlock(&m->handle); }
+
+void btk_cond_init(btk_cond_t *c) { pthread_cond_init(&c->handle, NULL); }
+void btk_cond_destroy(btk_cond_t *c) { pthread_cond_destroy(&c->handle); }
+void btk_cond_wait(btk_cond_t *c, btk_mutex_t *m) { pthread_cond_wait(&c->handle, &m->handle); }
+void btk_cond_signal(btk_cond_t *c) { pthread_cond_signal(&c->handle); }
+void btk_cond_broadcast(btk_cond_t *c) { pthread_cond_broadcast(&c->handle); }
+#endif // _WIN32
+
+#endif // BTK_THREAD_IMPLEMENTATION
@@ -0,0 +1,676 @@
+/*
+
+   `check.c` - Differential checks of the search engine, run it with `make check`
+
+   Random buffers are searched through the public API and the matches are compared against naive reference searches
+   written here, so a change to find_pattern(), glob_find(), fuzzy_find() or the short literal scanners could be
+   verified. Every buffer is searched as a whole, in chunks by multiple threads and as a stream read a few bytes at
+   a time, so the scanners have to agree with each other too. The suffix array index is checked against searching
+   its files. `check [ROUNDS] [SEED]` runs more rounds or another seed, the defaults are fixed so a failure reproduces
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "notgrep.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////
+///
+/// Utilities
+///
+
+#define NPOS SIZE_MAX
+#define DEFAULT_ROUNDS 2000
+#define DEFAULT_SEED 0x6e6f7467726570ull
+#define MAX_BUFFER_SIZE 400
+
+uint64_t rng_state;
+
+uint64_t rng_next(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+size_t rng_below(size_t n)
+{
+    return (size_t)(rng_next() % n);
+}
+
+// Random text of the bytes of `alphabet`, a byte that repeats in it is more likely
+size_t random_text(char *dst, size_t max_count, const char *alphabet)
+{
+    size_t count = rng_below(max_count + 1);
+    size_t alphabet_len = strlen(alphabet);
+    for(size_t i = 0; i < count; ++i) dst[i] = alphabet[rng_below(alphabet_len)];
+    return count;
+}
+
+typedef struct Match {
+    uint64_t row;
+    uint64_t offset;
+    size_t len;
+    char path[64];
+} Match;
+
+typedef struct Matches {
+    Match *items;
+    size_t count;
+    size_t capacity;
+} Matches;
+
+void matches_append(Matches *ms, Match m)
+{
+    if(ms->count >= ms->capacity) {
+        ms->capacity = ms->capacity == 0 ? 64 : ms->capacity*2;
+        ms->items = realloc(ms->items, ms->capacity*sizeof(Match));
+        if(ms->items == NULL) {
+            fprintf(stderr, "ERROR: Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ms->items[ms->count++] = m;
+}
+
+int collect_match(void *user, const ng_match_t *match)
+{
+    if(match->kind != NG_RECORD_MATCH) return 0;
+    Match m = { .row = match->row, .offset = match->offset, .len = match->len };
+    size_t path_len = match->path_len < sizeof(m.path) - 1 ? match->path_len : sizeof(m.path) - 1;
+    memcpy(m.path, match->path, path_len);
+    matches_append(user, m);
+    return 0;
+}
+
+void print_escaped(FILE *fp, const char *data, size_t count)
+{
+    for(size_t i = 0; i < count; ++i) {
+        unsigned char ch = (unsigned char)data[i];
+        if(ch == '\n') fprintf(fp, "\\n");
+        else if(ch == '\\') fprintf(fp, "\\\\");
+        else if(ch < 0x20 || ch >= 0x7f) fprintf(fp, "\\x%02x", ch);
+        else fputc(ch, fp);
+    }
+}
+
+size_t failures;
+
+// This function returns bool which is true if both have the same matches in the same order
+bool matches_equal(const Matches *a, const Matches *b)
+{
+    if(a->count != b->count) return false;
+    for(size_t i = 0; i < a->count; ++i) {
+        const Match *x = &a->items[i];
+        const Match *y = &b->items[i];
+        if(x->row != y->row || x->offset != y->offset || x->len != y->len || strcmp(x->path, y->path) != 0) return false;
+    }
+    return true;
+}
+
+void report_mismatch(const char *what, const char *pattern, size_t pattern_len, const char *data, size_t count,
+        const Matches *expected, const Matches *got)
+{
+    failures += 1;
+    if(failures > 10) return;
+    fprintf(stderr, "FAIL: %s, pattern \"", what);
+    print_escaped(stderr, pattern, pattern_len);
+    fprintf(stderr, "\" in \"");
+    print_escaped(stderr, data, count);
+    fprintf(stderr, "\"\n  expected:");
+    for(size_t i = 0; i < expected->count; ++i) {
+        fprintf(stderr, " %"PRIu64":%"PRIu64"+%zu", expected->items[i].row, expected->items[i].offset, expected->items[i].len);
+    }
+    fprintf(stderr, "\n  got:     ");
+    for(size_t i = 0; i < got->count; ++i) {
+        fprintf(stderr, " %"PRIu64":%"PRIu64"+%zu", got->items[i].row, got->items[i].offset, got->items[i].len);
+    }
+    fprintf(stderr, "\n");
+}
+
+///////////////////////////////////////////
+///
+/// Reference searches
+///
+
+typedef enum Boundary {
+    BOUNDARY_NONE = 0,
+    BOUNDARY_WORD,
+    BOUNDARY_LINE,
+} Boundary;
+
+bool is_word_byte(int ch)
+{
+    return ch >= 0x80 || ch == '_' || (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+bool has_boundaries(Boundary boundary, const char *data, size_t count, size_t pos, size_t len)
+{
+    int before = pos > 0 ? (unsigned char)data[pos - 1] : -1;
+    int after = pos + len < count ? (unsigned char)data[pos + len] : -1;
+    if(boundary == BOUNDARY_LINE) return (before < 0 || before == '\n') && (after < 0 || after == '\n');
+    return (before < 0 || !is_word_byte(before)) && (after < 0 || !is_word_byte(after));
+}
+
+typedef struct Reference Reference;
+// Find the first match starting from `from`, without the boundaries
+typedef size_t (*ReferenceFindFn)(const Reference *ref, const char *data, size_t count, size_t from, size_t *len);
+
+struct Reference {
+    const char *pattern;
+    size_t pattern_len;
+    Boundary boundary;
+    size_t max_errors;
+    ReferenceFindFn find;
+    // The glob parsed into its bytes, a '*' before a byte is a flag of that byte
+    size_t glob_count;
+    bool glob_accepts[64][256];
+    bool glob_star_before[64];
+};
+
+size_t reference_find_literal(const Reference *ref, const char *data, size_t count, size_t from, size_t *len)
+{
+    *len = ref->pattern_len;
+    for(size_t i = from; i + ref->pattern_len <= count; ++i) {
+        if(memcmp(data + i, ref->pattern, ref->pattern_len) == 0) return i;
+    }
+    return NPOS;
+}
+
+// Whether the glob matches all of data[begin..end). matched[t] is whether the first t bytes of the glob match the
+// text so far, a '*' before the byte t keeps it matched over any byte but a newline
+bool glob_matches_whole(const Reference *ref, const char *data, size_t begin, size_t end)
+{
+    bool matched[65] = { true };
+    for(size_t i = begin; i < end; ++i) {
+        unsigned char ch = (unsigned char)data[i];
+        bool next[65] = { false };
+        for(size_t t = 0; t < ref->glob_count; ++t) {
+            if(!matched[t]) continue;
+            if(ref->glob_accepts[t][ch]) next[t + 1] = true;
+            if(ref->glob_star_before[t] && ch != '\n') next[t] = true;
+        }
+        memcpy(matched, next, sizeof(matched));
+    }
+    return matched[ref->glob_count];
+}
+
+// The match that ends first, and of the ones that end there the longest
+size_t reference_find_glob(const Reference *ref, const char *data, size_t count, size_t from, size_t *len)
+{
+    for(size_t end = from + 1; end <= count; ++end) {
+        size_t line_begin = end - 1;
+        while(line_begin > from && data[line_begin - 1] != '\n') line_begin -= 1;
+        for(size_t start = line_begin; start < end; ++start) {
+            if(glob_matches_whole(ref, data, start, end)) {
+                *len = end - start;
+                return start;
+            }
+        }
+    }
+    return NPOS;
+}
+
+// Parse the subset of the glob syntax that random_glob() makes. A '*' before the first byte or after the last one
+// doesn't change which lines match, so it's dropped like the engine does
+void reference_parse_glob(Reference *ref)
+{
+    bool star = false;
+    ref->glob_count = 0;
+    for(size_t i = 0; i < ref->pattern_len; ++i) {
+        char ch = ref->pattern[i];
+        if(ch == '*') {
+            star = true;
+            continue;
+        }
+        bool *accepts = ref->glob_accepts[ref->glob_count];
+        memset(accepts, 0, 256);
+        if(ch == '?') {
+            memset(accepts, 1, 256);
+        } else if(ch == '[') {
+            bool negated = ref->pattern[i + 1] == '!';
+            size_t j = negated ? i + 2 : i + 1;
+            for(; ref->pattern[j] != ']'; ++j) accepts[(unsigned char)ref->pattern[j]] = true;
+            if(negated) {
+                for(int c = 0; c < 256; ++c) accepts[c] = !accepts[c];
+            }
+            i = j;
+        } else {
+            if(ch == '\\') ch = ref->pattern[++i];
+            accepts[(unsigned char)ch] = true;
+        }
+        accepts['\n'] = false;
+        ref->glob_star_before[ref->glob_count] = star && ref->glob_count > 0;
+        star = false;
+        ref->glob_count += 1;
+    }
+}
+
+// Sellers' dynamic programming: column[i] is the least edit distance between the first i bytes of the pattern and
+// a text that ends at the current byte and starts anywhere from `from` in the same line
+size_t reference_find_fuzzy(const Reference *ref, const char *data, size_t count, size_t from, size_t *len)
+{
+    size_t m = ref->pattern_len;
+    int64_t k = (int64_t)ref->max_errors;
+    int64_t *column = malloc((m + 1)*sizeof(int64_t));
+    int64_t *next = malloc((m + 1)*sizeof(int64_t));
+    for(size_t i = 0; i <= m; ++i) column[i] = (int64_t)i;
+    size_t end = NPOS;
+    for(size_t t = from; t < count && end == NPOS; ++t) {
+        if(data[t] == '\n') {
+            for(size_t i = 0; i <= m; ++i) column[i] = (int64_t)i;
+            continue;
+        }
+        next[0] = 0;
+        for(size_t i = 1; i <= m; ++i) {
+            int64_t best = column[i - 1] + (ref->pattern[i - 1] != data[t]);
+            if(column[i] + 1 < best) best = column[i] + 1;
+            if(next[i - 1] + 1 < best) best = next[i - 1] + 1;
+            next[i] = best;
+        }
+        memcpy(column, next, (m + 1)*sizeof(int64_t));
+        if(column[m] <= k) end = t + 1;
+    }
+    if(end == NPOS) {
+        free(column);
+        free(next);
+        return NPOS;
+    }
+    // The end moves forward while it makes the match closer
+    for(int64_t score = column[m]; score > 0 && end < count && data[end] != '\n'; ++end) {
+        next[0] = 0;
+        for(size_t i = 1; i <= m; ++i) {
+            int64_t best = column[i - 1] + (ref->pattern[i - 1] != data[end]);
+            if(column[i] + 1 < best) best = column[i] + 1;
+            if(next[i - 1] + 1 < best) best = next[i - 1] + 1;
+            next[i] = best;
+        }
+        if(next[m] >= score) break;
+        memcpy(column, next, (m + 1)*sizeof(int64_t));
+        score = column[m];
+    }
+    // The start is the closest one of the whole pattern to data[start..end), the shortest of those
+    size_t longest = m + ref->max_errors;
+    size_t lowest = end - from > longest ? end - longest : from;
+    for(size_t i = 0; i <= m; ++i) column[i] = (int64_t)i;
+    size_t start = end;
+    int64_t best_score = INT64_MAX;
+    for(size_t j = end; j > lowest && data[j - 1] != '\n'; --j) {
+        next[0] = column[0] + 1;
+        for(size_t i = 1; i <= m; ++i) {
+            int64_t best = column[i - 1] + (ref->pattern[m - i] != data[j - 1]);
+            if(column[i] + 1 < best) best = column[i] + 1;
+            if(next[i - 1] + 1 < best) best = next[i - 1] + 1;
+            next[i] = best;
+        }
+        memcpy(column, next, (m + 1)*sizeof(int64_t));
+        if(column[m] < best_score) {
+            best_score = column[m];
+            start = j - 1;
+        }
+    }
+    free(column);
+    free(next);
+    *len = end - start;
+    return start;
+}
+
+// The matches don't overlap, the next one is searched from the end of the last one. With -w/-x a candidate without
+// the boundaries is skipped by a byte
+void reference_search(const Reference *ref, const char *data, size_t count, Matches *out)
+{
+    size_t cursor = 0;
+    uint64_t row = 0;
+    size_t counted = 0;
+    while(cursor < count) {
+        size_t len = 0;
+        size_t from = cursor;
+        size_t pos = NPOS;
+        while(from <= count) {
+            pos = ref->find(ref, data, count, from, &len);
+            if(pos == NPOS || ref->boundary == BOUNDARY_NONE || has_boundaries(ref->boundary, data, count, pos, len)) break;
+            from = pos + 1;
+            pos = NPOS;
+        }
+        if(pos == NPOS) break;
+        for(; counted < pos; ++counted) row += data[counted] == '\n';
+        matches_append(out, (Match){ .row = row, .offset = pos, .len = len });
+        cursor = pos + (len > 0 ? len : 1);
+    }
+}
+
+///////////////////////////////////////////
+///
+/// Engine searches
+///
+
+typedef struct ChunkReader {
+    const char *data;
+    size_t count;
+    size_t at;
+} ChunkReader;
+
+// A few bytes at a time, so the stream scanner refills its window in the middle of lines and matches
+size_t read_random_chunk(void *user, char *buf, size_t bufsz)
+{
+    ChunkReader *cr = user;
+    size_t n = 1 + rng_below(17);
+    if(n > bufsz) n = bufsz;
+    if(n > cr->count - cr->at) n = cr->count - cr->at;
+    memcpy(buf, cr->data + cr->at, n);
+    cr->at += n;
+    return n;
+}
+
+typedef enum SearchMode {
+    SEARCH_BUFFER = 0,
+    SEARCH_CHUNKED,
+    SEARCH_STREAM,
+    SEARCH_MODE_COUNT,
+} SearchMode;
+
+const char *search_mode_names[SEARCH_MODE_COUNT] = { "buffer", "chunked", "stream" };
+
+void engine_search(const ng_pattern_t *pattern, SearchMode mode, const char *data, size_t count, Matches *out)
+{
+    ng_search_options_t options = ng_search_default_options();
+    if(mode == SEARCH_CHUNKED) {
+        options.thread_count = 3;
+        options.chunk_threshold = 1;
+    }
+    ng_searcher_t *searcher = ng_searcher_new(pattern, &options, collect_match, out);
+    if(searcher == NULL) {
+        fprintf(stderr, "ERROR: Couldn't create a searcher\n");
+        exit(EXIT_FAILURE);
+    }
+    if(mode == SEARCH_STREAM) {
+        ChunkReader cr = { .data = data, .count = count };
+        ng_search_stream(searcher, "", read_random_chunk, &cr);
+    } else {
+        ng_search_buffer(searcher, "", data, count);
+    }
+    ng_searcher_free(searcher);
+}
+
+// Search `data` with every mode and compare the matches against the reference
+void check_pattern(const char *what, const Reference *ref, const ng_pattern_options_t *options, const char *data, size_t count)
+{
+    ng_pattern_t *pattern;
+    if(ng_pattern_compile(&pattern, ref->pattern, ref->pattern_len, options) != NG_OK) {
+        failures += 1;
+        fprintf(stderr, "FAIL: %s, couldn't compile \"", what);
+        print_escaped(stderr, ref->pattern, ref->pattern_len);
+        fprintf(stderr, "\"\n");
+        return;
+    }
+    Matches expected = {0};
+    reference_search(ref, data, count, &expected);
+    for(int mode = 0; mode < SEARCH_MODE_COUNT; ++mode) {
+        Matches got = {0};
+        engine_search(pattern, (SearchMode)mode, data, count, &got);
+        if(!matches_equal(&expected, &got)) {
+            char label[128];
+            snprintf(label, sizeof(label), "%s (%s, boundary %d)", what, search_mode_names[mode], (int)ref->boundary);
+            report_mismatch(label, ref->pattern, ref->pattern_len, data, count, &expected, &got);
+        }
+        free(got.items);
+    }
+    free(expected.items);
+    ng_pattern_free(pattern);
+}
+
+///////////////////////////////////////////
+///
+/// Checks
+///
+
+#define TEXT_ALPHABET "aaabbc_ \n"
+
+// Literals of 1 to 4 bytes have their own scanners, the longer ones are found by the generic search
+void check_literals(size_t rounds)
+{
+    char data[MAX_BUFFER_SIZE];
+    char pattern[16];
+    for(size_t r = 0; r < rounds; ++r) {
+        size_t count = random_text(data, sizeof(data), TEXT_ALPHABET);
+        size_t pattern_len = 1 + rng_below(6);
+        for(size_t i = 0; i < pattern_len; ++i) pattern[i] = "aabc_ "[rng_below(6)];
+        Reference ref = {
+            .pattern = pattern,
+            .pattern_len = pattern_len,
+            .boundary = (Boundary)rng_below(3),
+            .find = reference_find_literal,
+        };
+        ng_pattern_options_t options = ng_pattern_default_options();
+        options.whole_word = ref.boundary == BOUNDARY_WORD;
+        options.whole_line = ref.boundary == BOUNDARY_LINE;
+        check_pattern("literal", &ref, &options, data, count);
+    }
+}
+
+// A glob of plain bytes, '?', sets and '*' between them
+size_t random_glob(char *dst)
+{
+    size_t count = 0;
+    size_t tokens = 1 + rng_below(5);
+    if(rng_below(4) == 0) dst[count++] = '*';
+    for(size_t t = 0; t < tokens; ++t) {
+        switch(rng_below(8)) {
+            case 0: dst[count++] = '?'; break;
+            case 1: memcpy(dst + count, "[ab]", 4); count += 4; break;
+            case 2: memcpy(dst + count, "[!a]", 4); count += 4; break;
+            case 3: memcpy(dst + count, "\\*", 2); count += 2; break;
+            default: dst[count++] = "abc_"[rng_below(4)]; break;
+        }
+        if(rng_below(3) == 0) dst[count++] = '*';
+    }
+    return count;
+}
+
+void check_globs(size_t rounds)
+{
+    char data[MAX_BUFFER_SIZE];
+    char pattern[64];
+    for(size_t r = 0; r < rounds; ++r) {
+        size_t count = random_text(data, 120, "aaabbc*_ \n");
+        Reference ref = {
+            .pattern = pattern,
+            .pattern_len = random_glob(pattern),
+            .boundary = (Boundary)rng_below(3),
+            .find = reference_find_glob,
+        };
+        reference_parse_glob(&ref);
+        if(ref.glob_count == 0) continue;
+        ng_pattern_options_t options = ng_pattern_default_options();
+        options.glob = 1;
+        options.whole_word = ref.boundary == BOUNDARY_WORD;
+        options.whole_line = ref.boundary == BOUNDARY_LINE;
+        check_pattern("glob", &ref, &options, data, count);
+    }
+}
+
+// Patterns of up to 64 bytes are one word of the bit-vector, the longer ones are chained across two
+void check_fuzzy(size_t rounds)
+{
+    char data[MAX_BUFFER_SIZE];
+    char pattern[128];
+    for(size_t r = 0; r < rounds; ++r) {
+        bool long_pattern = rng_below(8) == 0;
+        size_t count = long_pattern ? random_text(data, sizeof(data), "aaaaaaaaaaaaaaaaaaaab\n")
+                                    : random_text(data, sizeof(data), TEXT_ALPHABET);
+        size_t pattern_len = long_pattern ? 60 + rng_below(40) : 2 + rng_below(8);
+        const char *pattern_alphabet = long_pattern ? "aaaaaaaaaaaaaaab" : "aabc_";
+        for(size_t i = 0; i < pattern_len; ++i) pattern[i] = pattern_alphabet[rng_below(strlen(pattern_alphabet))];
+        size_t max_errors = 1 + rng_below(long_pattern ? 8 : (pattern_len < 4 ? pattern_len - 1 : 3));
+        Reference ref = {
+            .pattern = pattern,
+            .pattern_len = pattern_len,
+            .boundary = (Boundary)rng_below(3),
+            .max_errors = max_errors,
+            .find = reference_find_fuzzy,
+        };
+        ng_pattern_options_t options = ng_pattern_default_options();
+        options.max_errors = max_errors;
+        options.whole_word = ref.boundary == BOUNDARY_WORD;
+        options.whole_line = ref.boundary == BOUNDARY_LINE;
+        check_pattern("fuzzy", &ref, &options, data, count);
+    }
+}
+
+// Every other glob is 8 to 12 runs of up to 4 of 12 different bytes with '*' between them. Those make DFA states that
+// go to more than 8 other states, so the JIT emits jump tables for them besides the chains of compares. The compiled
+// code has to find the same matches as the reference, the table interpreter is checked by check_globs()
+void check_jit(size_t rounds)
+{
+    char data[MAX_BUFFER_SIZE];
+    char pattern[128];
+    for(size_t r = 0; r < rounds; ++r) {
+        size_t count = random_text(data, 160, "abcdefghijkl abcdefghijkl\n");
+        size_t pattern_len = 0;
+        if(r % 2 == 0) {
+            size_t tokens = 1 + rng_below(12);
+            for(size_t t = 0; t < tokens; ++t) {
+                switch(rng_below(6)) {
+                    case 0: pattern[pattern_len++] = '?'; break;
+                    case 1: memcpy(pattern + pattern_len, "[abcdef]", 8); pattern_len += 8; break;
+                    default: pattern[pattern_len++] = "abcdefghijkl"[rng_below(12)]; break;
+                }
+                if(t + 1 < tokens && rng_below(2) == 0) pattern[pattern_len++] = '*';
+            }
+        } else {
+            size_t runs = 8 + rng_below(5);
+            for(size_t t = 0; t < runs; ++t) {
+                size_t run_len = 1 + rng_below(4);
+                for(size_t i = 0; i < run_len; ++i) pattern[pattern_len++] = "abcdefghijkl"[rng_below(12)];
+                if(t + 1 < runs) pattern[pattern_len++] = '*';
+            }
+        }
+        Reference ref = {
+            .pattern = pattern,
+            .pattern_len = pattern_len,
+            .boundary = (Boundary)rng_below(3),
+            .find = reference_find_glob,
+        };
+        reference_parse_glob(&ref);
+        ng_pattern_options_t options = ng_pattern_default_options();
+        options.glob = 1;
+        options.jit = 1;
+        options.whole_word = ref.boundary == BOUNDARY_WORD;
+        options.whole_line = ref.boundary == BOUNDARY_LINE;
+        check_pattern("jit", &ref, &options, data, count);
+    }
+}
+
+#ifndef _WIN32
+#define SUFFIX_ARRAY_FILES 4
+
+// The suffix array search has to find what searching its files finds, it never reads the files so the whole
+// corpus is the index
+void check_suffix_array(size_t rounds)
+{
+    char dir[] = "/tmp/notgrep-check-XXXXXX";
+    if(mkdtemp(dir) == NULL) {
+        fprintf(stderr, "WARNING: Couldn't make a temporary directory, the suffix array isn't checked\n");
+        return;
+    }
+    char paths[SUFFIX_ARRAY_FILES][64];
+    char indexpath[64];
+    snprintf(indexpath, sizeof(indexpath), "%s/index.nsa", dir);
+    static char contents[SUFFIX_ARRAY_FILES][MAX_BUFFER_SIZE];
+    size_t counts[SUFFIX_ARRAY_FILES];
+    char pattern[16];
+    for(size_t r = 0; r < rounds/10 + 1; ++r) {
+        ng_suffix_array_builder_t *builder = ng_suffix_array_builder_new();
+        for(size_t f = 0; f < SUFFIX_ARRAY_FILES; ++f) {
+            snprintf(paths[f], sizeof(paths[f]), "%s/%zu.txt", dir, f);
+            counts[f] = random_text(contents[f], sizeof(contents[f]), TEXT_ALPHABET);
+            FILE *fp = fopen(paths[f], "wb");
+            if(fp == NULL || fwrite(contents[f], 1, counts[f], fp) != counts[f]) {
+                fprintf(stderr, "ERROR: Couldn't write %s\n", paths[f]);
+                exit(EXIT_FAILURE);
+            }
+            fclose(fp);
+            ng_suffix_array_add_file(builder, paths[f]);
+        }
+        int err = ng_suffix_array_write(builder, indexpath);
+        ng_suffix_array_builder_free(builder);
+        ng_suffix_array_t *index;
+        if(err != NG_OK || ng_suffix_array_open(&index, indexpath) != NG_OK) {
+            failures += 1;
+            fprintf(stderr, "FAIL: suffix array, couldn't write or open %s: %s\n", indexpath, ng_explain(err));
+            break;
+        }
+
+        for(size_t p = 0; p < 10; ++p) {
+            size_t pattern_len = 1 + rng_below(5);
+            for(size_t i = 0; i < pattern_len; ++i) pattern[i] = "aabc_ "[rng_below(6)];
+            Boundary boundary = (Boundary)rng_below(3);
+            ng_pattern_options_t options = ng_pattern_default_options();
+            options.whole_word = boundary == BOUNDARY_WORD;
+            options.whole_line = boundary == BOUNDARY_LINE;
+            ng_pattern_t *compiled;
+            if(ng_pattern_compile(&compiled, pattern, pattern_len, &options) != NG_OK) continue;
+
+            Matches expected = {0};
+            Matches got = {0};
+            ng_searcher_t *searcher = ng_searcher_new(compiled, NULL, collect_match, &expected);
+            for(size_t f = 0; f < SUFFIX_ARRAY_FILES; ++f) ng_search_buffer(searcher, paths[f], contents[f], counts[f]);
+            ng_searcher_free(searcher);
+            searcher = ng_searcher_new(compiled, NULL, collect_match, &got);
+            ng_search_suffix_array(searcher, index);
+            ng_searcher_free(searcher);
+            if(!matches_equal(&expected, &got)) {
+                char label[64];
+                snprintf(label, sizeof(label), "suffix array (boundary %d)", (int)boundary);
+                report_mismatch(label, pattern, pattern_len, contents[0], counts[0], &expected, &got);
+            }
+            free(expected.items);
+            free(got.items);
+            ng_pattern_free(compiled);
+        }
+        ng_suffix_array_close(index);
+    }
+    for(size_t f = 0; f < SUFFIX_ARRAY_FILES; ++f) remove(paths[f]);
+    remove(indexpath);
+    rmdir(dir);
+}
+#endif // _WIN32
+
+int main(int argc, const char **argv)
+{
+    size_t rounds = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : DEFAULT_ROUNDS;
+    rng_state = argc > 2 ? strtoull(argv[2], NULL, 0) : DEFAULT_SEED;
+    if(rng_state == 0) rng_state = DEFAULT_SEED;
+
+    check_literals(rounds);
+    printf("literals:     %s\n", failures == 0 ? "ok" : "FAILED");
+    size_t before = failures;
+    check_globs(rounds);
+    printf("globs:        %s\n", failures == before ? "ok" : "FAILED");
+    before = failures;
+    check_jit(rounds);
+    printf("jit:          %s\n", failures == before ? "ok" : "FAILED");
+    before = failures;
+    check_fuzzy(rounds);
+    printf("fuzzy:        %s\n", failures == before ? "ok" : "FAILED");
+#ifndef _WIN32
+    before = failures;
+    check_suffix_array(rounds);
+    printf("suffix array: %s\n", failures == before ? "ok" : "FAILED");
+#endif // _WIN32
+
+    if(failures > 0) {
+        fprintf(stderr, "%zu checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
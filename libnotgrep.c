@@ -0,0 +1,4296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#define BTK_STRUTIL_IMPLEMENTATION
+#include "btk_strutil.h"
+
+#define BTK_ARENA_IMPLEMENTATION
+#include "btk_arena.h"
+
+#define BTK_THREAD_IMPLEMENTATION
+#include "btk_thread.h"
+
+#include "btk_fsutil.h"
+
+#include "notgrep.h"
+
+#ifdef _WIN32
+#include "windows_dirent.h"
+#else
+#include "dirent.h"
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NOTGREP_SSE2
+#endif
+
+// The globs are compiled to machine code only on x86-64 with the System V calling convention
+#if defined(__x86_64__) && !defined(_WIN32)
+#include <sys/mman.h>
+#define NOTGREP_JIT
+#endif
+
+///////////////////////////////////////////
+///
+/// Utilities
+///
+
+// This function returns bool which is true if none of the bytes has the high bit set. The blocks are OR-ed
+// together so there's only a single test of the high bits at the end
+bool is_ascii(const char *data, size_t count)
+{
+    size_t i = 0;
+    unsigned char high = 0;
+#ifdef NOTGREP_SSE2
+    __m128i acc = _mm_setzero_si128();
+    for(; i + 16 <= count; i += 16) acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(data + i)));
+    if(_mm_movemask_epi8(acc) != 0) return false;
+#else
+    uint64_t acc = 0;
+    for(; i + 8 <= count; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        acc |= word;
+    }
+    if((acc & 0x8080808080808080ull) != 0) return false;
+#endif
+    for(; i < count; ++i) high |= (unsigned char)data[i];
+    return (high & 0x80) == 0;
+}
+
+// Grow a malloc-ed array so it has room for `needed` items. The indexes made by the library could be much bigger
+// than what an arena is for
+// This function returns bool which is false if there's no memory
+bool grow_array(void **items, size_t *capacity, size_t needed, size_t item_size)
+{
+    if(needed <= *capacity) return true;
+    size_t new_capacity = *capacity == 0 ? 1024 : *capacity;
+    while(new_capacity < needed) new_capacity *= 2;
+    void *new_items = realloc(*items, new_capacity*item_size);
+    if(new_items == NULL) return false;
+    *items = new_items;
+    *capacity = new_capacity;
+    return true;
+}
+
+uint64_t hash_path_bytes(uint64_t hash, const char *data, size_t count)
+{
+    // FNV-1a
+    for(size_t i = 0; i < count; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+#define HASH_SEED 14695981039346656037ull
+
+typedef void (*WalkFileFn)(void *user, const char *filepath);
+
+// Call `on_file` for every file under the directory in `*pathbuf`, the names of the entries are put after it. It's
+// for building the indexes, the search has its own walk that doesn't make the full paths
+void walk_dir(char **pathbuf, size_t *pathbufsz, size_t path_len, WalkFileFn on_file, void *user)
+{
+    DIR *dp = opendir(*pathbuf);
+    if(dp == NULL) return;
+    struct dirent *ep;
+    while((ep = readdir(dp)) != NULL) {
+        if(strcmp(ep->d_name, ".") == 0 || strcmp(ep->d_name, "..") == 0) continue;
+        size_t name_len = strlen(ep->d_name);
+        size_t separator = (*pathbuf)[path_len - 1] != BTKFS_PATHSEP ? 1 : 0;
+        size_t len = path_len + separator + name_len;
+        if(!grow_array((void **)pathbuf, pathbufsz, len + 1, sizeof(char))) break;
+        if(separator) (*pathbuf)[path_len] = BTKFS_PATHSEP;
+        memcpy(*pathbuf + path_len + separator, ep->d_name, name_len + 1);
+        if(btkfs_isdir(*pathbuf)) walk_dir(pathbuf, pathbufsz, len, on_file, user);
+        else on_file(user, *pathbuf);
+        (*pathbuf)[path_len] = 0;
+    }
+    closedir(dp);
+}
+
+// The column in characters after the first `count` bytes of a line. It's the number of bytes if they're not
+// valid UTF-8, so a binary file still gets a sensible column
+size_t utf8_column(const char *line, size_t count)
+{
+    if(is_ascii(line, count)) return count;
+    size_t chars = 0;
+    for(size_t i = 0; i < count; chars += 1) {
+        unsigned char ch = (unsigned char)line[i];
+        size_t len = ch < 0x80 ? 1 : ch < 0xC2 ? 0 : ch < 0xE0 ? 2 : ch < 0xF0 ? 3 : ch < 0xF5 ? 4 : 0;
+        if(len == 0 || i + len > count) return count;
+        for(size_t j = 1; j < len; ++j) {
+            if(((unsigned char)line[i + j] & 0xC0) != 0x80) return count;
+        }
+        i += len;
+    }
+    return chars;
+}
+
+///////////////////////////////////////////
+///
+/// Short literals
+///
+
+// The literals of 1 to 4 bytes get a scanner made for their length when the pattern is compiled. All of their
+// bytes are compared at once, so a candidate never has to be verified. Longer ones go to btk_sv_find()
+typedef btksu_size_t (*LiteralFindFn)(btk_stringview_t haystack, btk_stringview_t needle);
+
+btksu_size_t find_literal_1(btk_stringview_t haystack, btk_stringview_t needle)
+{
+    const char *found = haystack.count > 0 ? memchr(haystack.data, (unsigned char)needle.data[0], haystack.count) : NULL;
+    return found ? (btksu_size_t)(found - haystack.data) : BTK_SV_NPOS;
+}
+
+#ifdef NOTGREP_SSE2
+// Every byte of the literal is compared with a block loaded from where that byte would be, so a bit of the mask
+// is only set where all of them are equal
+#define SHORT_LITERAL_LOAD(k) _mm_loadu_si128((const __m128i *)(h + i + (k)))
+#define SHORT_LITERAL_SSE2_SCAN(N)                                                                    \
+    const __m128i b0 = _mm_set1_epi8(needle.data[0]);                                                 \
+    const __m128i b1 = _mm_set1_epi8(needle.data[(N) > 1 ? 1 : 0]);                                   \
+    const __m128i b2 = _mm_set1_epi8(needle.data[(N) > 2 ? 2 : 0]);                                   \
+    const __m128i b3 = _mm_set1_epi8(needle.data[(N) > 3 ? 3 : 0]);                                   \
+    for(; i + 16 + (N) - 1 <= n; i += 16) {                                                           \
+        __m128i eq = _mm_cmpeq_epi8(SHORT_LITERAL_LOAD(0), b0);                                       \
+        if((N) > 1) eq = _mm_and_si128(eq, _mm_cmpeq_epi8(SHORT_LITERAL_LOAD(1), b1));                \
+        if((N) > 2) eq = _mm_and_si128(eq, _mm_cmpeq_epi8(SHORT_LITERAL_LOAD(2), b2));                \
+        if((N) > 3) eq = _mm_and_si128(eq, _mm_cmpeq_epi8(SHORT_LITERAL_LOAD(3), b3));                \
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);                                      \
+        if(mask != 0) return i + btksu__ctz(mask);                                                    \
+    }
+#else
+#define SHORT_LITERAL_SSE2_SCAN(N)
+#endif
+
+// The rest is compared as a packed integer of N bytes
+#define DEFINE_FIND_SHORT_LITERAL(N)                                                                  \
+btksu_size_t find_literal_##N(btk_stringview_t haystack, btk_stringview_t needle)                     \
+{                                                                                                     \
+    const char *h = haystack.data;                                                                    \
+    size_t n = haystack.count;                                                                        \
+    size_t i = 0;                                                                                     \
+    SHORT_LITERAL_SSE2_SCAN(N)                                                                        \
+    uint32_t packed = 0;                                                                              \
+    memcpy(&packed, needle.data, (N));                                                                \
+    for(; i + (N) <= n; ++i) {                                                                        \
+        uint32_t word = 0;                                                                            \
+        memcpy(&word, h + i, (N));                                                                    \
+        if(word == packed) return i;                                                                  \
+    }                                                                                                 \
+    return BTK_SV_NPOS;                                                                               \
+}
+
+DEFINE_FIND_SHORT_LITERAL(2)
+DEFINE_FIND_SHORT_LITERAL(3)
+DEFINE_FIND_SHORT_LITERAL(4)
+
+LiteralFindFn choose_literal_finder(size_t count)
+{
+    switch(count) {
+        case 1: return find_literal_1;
+        case 2: return find_literal_2;
+        case 3: return find_literal_3;
+        case 4: return find_literal_4;
+        default: return btk_sv_find;
+    }
+}
+
+///////////////////////////////////////////
+///
+/// Approximate matching
+///
+
+// Patterns are split into blocks of 64 bytes, this many blocks are kept on the stack while searching
+#define FUZZY_MAX_WORDS 64
+#define FUZZY_MAX_PATTERN_SIZE (FUZZY_MAX_WORDS*64)
+
+// A pattern matched within `max_errors` edits (insertions, deletions and substitutions) with Myers' bit-vector
+// algorithm. Every bit is a byte of the pattern, so a column of the edit distance table is a few words
+typedef struct FuzzyPattern {
+    size_t max_errors;
+    size_t len;
+    size_t words;
+    uint64_t last_high; // The bit of the last byte of the pattern in the last word
+    uint64_t *peq;          // [256][words], the bits of the bytes of the pattern that are equal to a byte
+    uint64_t *peq_reversed; // Same for the pattern backward, to find where a match starts
+} FuzzyPattern;
+
+typedef struct MyersState {
+    uint64_t pv[FUZZY_MAX_WORDS]; // The vertical deltas of the column that are +1
+    uint64_t mv[FUZZY_MAX_WORDS]; // The ones that are -1
+    int64_t score; // The distance at the last byte of the pattern
+} MyersState;
+
+void fuzzy_pattern_init(btk_arena_t *a, FuzzyPattern *fp, btk_stringview_t text, size_t max_errors)
+{
+    assert(text.count > 0 && text.count <= FUZZY_MAX_PATTERN_SIZE && "Invalid fuzzy pattern size");
+    fp->max_errors = max_errors;
+    fp->len = text.count;
+    fp->words = (text.count + 63)/64;
+    fp->last_high = 1ull << ((text.count - 1)%64);
+    fp->peq = btk_arena_alloc(a, 256*fp->words*sizeof(uint64_t));
+    fp->peq_reversed = btk_arena_alloc(a, 256*fp->words*sizeof(uint64_t));
+    memset(fp->peq, 0, 256*fp->words*sizeof(uint64_t));
+    memset(fp->peq_reversed, 0, 256*fp->words*sizeof(uint64_t));
+    for(size_t i = 0; i < text.count; ++i) {
+        unsigned char ch = (unsigned char)text.data[i];
+        size_t j = text.count - 1 - i;
+        fp->peq[ch*fp->words + i/64] |= 1ull << (i%64);
+        fp->peq_reversed[(unsigned char)text.data[j]*fp->words + i/64] |= 1ull << (i%64);
+    }
+}
+
+void myers_reset(const FuzzyPattern *fp, MyersState *st)
+{
+    for(size_t b = 0; b < fp->words; ++b) {
+        st->pv[b] = ~0ull;
+        st->mv[b] = 0;
+    }
+    st->score = (int64_t)fp->len;
+}
+
+// Advance the column of a block by a byte. `hin` is the horizontal delta coming from the row above the block
+// This function returns int which is the horizontal delta of the last row of the block
+static inline int myers_advance_block(uint64_t *pv, uint64_t *mv, uint64_t eq, uint64_t high, int hin)
+{
+    uint64_t xv = eq | *mv;
+    if(hin < 0) eq |= 1;
+    uint64_t xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+    uint64_t ph = *mv | ~(xh | *pv);
+    uint64_t mh = *pv & xh;
+    int hout = (ph & high) ? 1 : (mh & high) ? -1 : 0;
+    ph <<= 1;
+    mh <<= 1;
+    if(hin < 0) mh |= 1;
+    else if(hin > 0) ph |= 1;
+    *pv = mh | ~(xv | ph);
+    *mv = ph & xv;
+    return hout;
+}
+
+// `hin` is 0 when a match may start at any byte of the text, and 1 when the text is anchored at the first byte
+static inline void myers_step(const FuzzyPattern *fp, const uint64_t *peq, MyersState *st, unsigned char ch, int hin)
+{
+    const uint64_t *eq = peq + ch*fp->words;
+    size_t last = fp->words - 1;
+    for(size_t b = 0; b < last; ++b) hin = myers_advance_block(&st->pv[b], &st->mv[b], eq[b], 1ull << 63, hin);
+    st->score += myers_advance_block(&st->pv[last], &st->mv[last], eq[last], fp->last_high, hin);
+}
+
+// Find the first match within the allowed errors that starts from `from`, a match never crosses a newline. The
+// scan finds where the match ends, the end is moved forward while it makes the match closer, then the start is
+// found by matching the pattern backward from the end
+// This function returns size_t which is the offset of the match in `data` or BTK_SV_NPOS
+size_t fuzzy_find(const FuzzyPattern *fp, btk_stringview_t data, size_t from, size_t *match_len)
+{
+    MyersState st;
+    myers_reset(fp, &st);
+    int64_t max_errors = (int64_t)fp->max_errors;
+    size_t end = BTK_SV_NPOS;
+    for(size_t i = from; i < data.count; ++i) {
+        // A match is inside a line, so every line starts over
+        if(data.data[i] == '\n') {
+            myers_reset(fp, &st);
+            continue;
+        }
+        myers_step(fp, fp->peq, &st, (unsigned char)data.data[i], 0);
+        if(st.score <= max_errors) {
+            end = i + 1;
+            break;
+        }
+    }
+    if(end == BTK_SV_NPOS) return BTK_SV_NPOS;
+    for(int64_t score = st.score; score > 0 && end < data.count && data.data[end] != '\n'; ++end) {
+        myers_step(fp, fp->peq, &st, (unsigned char)data.data[end], 0);
+        if(st.score >= score) break;
+        score = st.score;
+    }
+
+    size_t longest = fp->len + fp->max_errors;
+    size_t lowest = end - from > longest ? end - longest : from;
+    myers_reset(fp, &st);
+    size_t start = end;
+    int64_t best = INT64_MAX;
+    for(size_t j = end; j > lowest && data.data[j - 1] != '\n'; --j) {
+        myers_step(fp, fp->peq_reversed, &st, (unsigned char)data.data[j - 1], 1);
+        if(st.score < best) {
+            best = st.score;
+            start = j - 1;
+        }
+    }
+    assert(best <= max_errors && "The start of a fuzzy match is not found");
+    *match_len = end - start;
+    return start;
+}
+
+///////////////////////////////////////////
+///
+/// Glob patterns
+///
+
+// A glob has at most this many bytes that are not '*', every one of them is a bit of a word
+#define GLOB_MAX_TOKENS 64
+// A match with a '*' could be as long as its line, the scanners only keep this much of the data after the start
+// of a match. A longer match could be missed where the data is refilled or split
+#define GLOB_STAR_LOOKAHEAD (16*1024)
+#define GLOB_DFA_MAX_STATES 256
+#define GLOB_DFA_MATCH UINT16_MAX
+
+typedef size_t (*GlobJitFn)(const char *data, size_t begin, size_t end);
+
+// A glob matched inside a line: '?' is any byte, '[a-z]' and '[!a-z]' are sets of bytes, '*' is any run of bytes
+// and '\' takes the next byte as it is. It's simulated with Shift-And, every byte of the glob is a bit of the state
+// and a '*' is a bit that stays set. The longest run of plain bytes is a literal every match must contain, so
+// it's searched first and the glob is only run through the lines that have it
+typedef struct GlobPattern {
+    size_t count;
+    uint64_t masks[256];          // The bytes of the glob that accept a byte
+    uint64_t masks_reversed[256]; // Same for the glob backward, to find where a match starts
+    uint64_t stars;          // The bytes of the glob that are followed by a '*'
+    uint64_t stars_reversed;
+    btk_stringview_t literal;
+    LiteralFindFn find_literal;
+    uint16_t *dfa; // [dfa_states][256] the next state or GLOB_DFA_MATCH, NULL if the glob has too many states
+    size_t dfa_states;
+    GlobJitFn jit_scan; // The DFA compiled to machine code, NULL without the JIT
+    void *jit_code;
+    size_t jit_size;
+} GlobPattern;
+
+// This function returns bool which is false if the glob has nothing but '*' or too many bytes
+bool parse_glob_pattern(btk_arena_t *a, btk_stringview_t text, GlobPattern *g)
+{
+    *g = (GlobPattern){0};
+    bool star_pending = false;
+    char *plain = btk_arena_alloc(a, text.count + 1); // The byte of every token that is a single byte, 0 otherwise
+    bool is_plain[GLOB_MAX_TOKENS];
+    for(size_t i = 0; i < text.count; ++i) {
+        bool accepts[256] = {0};
+        unsigned char ch = (unsigned char)text.data[i];
+        if(ch == '*') {
+            star_pending = true;
+            continue;
+        } else if(ch == '?') {
+            memset(accepts, 1, sizeof(accepts));
+        } else if(ch == '[' && btk_sv_find_byte(btk_sv_slice(text, i + 2, text.count), ']') != BTK_SV_NPOS) {
+            size_t j = i + 1;
+            bool negated = text.data[j] == '!' || text.data[j] == '^';
+            if(negated) j += 1;
+            // A ']' right after the '[' is a member of the set
+            for(size_t first = j; j < text.count && (j == first || text.data[j] != ']'); ++j) {
+                unsigned char lo = (unsigned char)text.data[j];
+                unsigned char hi = lo;
+                if(j + 2 < text.count && text.data[j + 1] == '-' && text.data[j + 2] != ']') {
+                    hi = (unsigned char)text.data[j + 2];
+                    j += 2;
+                }
+                for(int c = lo; c <= hi; ++c) accepts[c] = true;
+            }
+            if(j >= text.count) return false;
+            if(negated) {
+                for(int c = 0; c < 256; ++c) accepts[c] = !accepts[c];
+            }
+            i = j;
+        } else {
+            if(ch == '\\' && i + 1 < text.count) ch = (unsigned char)text.data[++i];
+            accepts[ch] = true;
+        }
+        if(g->count == GLOB_MAX_TOKENS) return false;
+        // A '*' before the first byte or after the last one doesn't change which lines match, so it's dropped
+        if(star_pending && g->count > 0) g->stars |= 1ull << (g->count - 1);
+        star_pending = false;
+        accepts['\n'] = false;
+        size_t members = 0;
+        for(int c = 0; c < 256; ++c) {
+            if(!accepts[c]) continue;
+            g->masks[c] |= 1ull << g->count;
+            members += 1;
+            plain[g->count] = (char)c;
+        }
+        is_plain[g->count] = members == 1;
+        g->count += 1;
+    }
+    if(g->count == 0) return false;
+
+    for(size_t i = 0; i < g->count; ++i) {
+        size_t j = g->count - 1 - i;
+        for(int c = 0; c < 256; ++c) {
+            if(g->masks[c] & (1ull << j)) g->masks_reversed[c] |= 1ull << i;
+        }
+        if(j > 0 && (g->stars & (1ull << (j - 1)))) g->stars_reversed |= 1ull << i;
+    }
+    size_t run_start = 0;
+    for(size_t i = 0; i <= g->count; ++i) {
+        bool run_ends = i == g->count || !is_plain[i] || (i > 0 && (g->stars & (1ull << (i - 1))));
+        if(!run_ends) continue;
+        if(i - run_start > g->literal.count) g->literal = btk_sv_from_parts(plain + run_start, i - run_start);
+        run_start = i < g->count && is_plain[i] ? i : i + 1;
+    }
+    g->find_literal = choose_literal_finder(g->literal.count);
+    return true;
+}
+
+bool glob_has_stars(const GlobPattern *g)
+{
+    return g->stars != 0;
+}
+
+// The states of the glob (the Shift-And state words) that a line could get to are made into a DFA, so the scan is
+// a table load per byte. A glob with more states keeps being simulated bit by bit
+bool glob_build_dfa(btk_arena_t *a, GlobPattern *g)
+{
+    uint64_t accept = 1ull << (g->count - 1);
+    uint64_t *states = malloc(GLOB_DFA_MAX_STATES*sizeof(uint64_t));
+    uint16_t *dfa = malloc(GLOB_DFA_MAX_STATES*256*sizeof(uint16_t));
+    if(states == NULL || dfa == NULL) {
+        free(states);
+        free(dfa);
+        return false;
+    }
+    size_t count = 1;
+    states[0] = 0;
+    bool ok = true;
+    for(size_t s = 0; s < count && ok; ++s) {
+        for(int ch = 0; ch < 256; ++ch) {
+            uint64_t next = ch == '\n' ? 0 : (((states[s] << 1) | 1) & g->masks[ch]) | (states[s] & g->stars);
+            if(next & accept) {
+                dfa[s*256 + ch] = GLOB_DFA_MATCH;
+                continue;
+            }
+            size_t t = 0;
+            while(t < count && states[t] != next) t += 1;
+            if(t == count) {
+                if(count == GLOB_DFA_MAX_STATES) {
+                    ok = false;
+                    break;
+                }
+                states[count++] = next;
+            }
+            dfa[s*256 + ch] = (uint16_t)t;
+        }
+    }
+    if(ok) {
+        g->dfa_states = count;
+        g->dfa = btk_arena_bufdup(a, (const char *)dfa, count*256*sizeof(uint16_t));
+    }
+    free(states);
+    free(dfa);
+    return ok;
+}
+
+size_t glob_dfa_scan(const GlobPattern *g, btk_stringview_t data, size_t begin, size_t end)
+{
+    const unsigned char *bytes = (const unsigned char *)data.data;
+    uint16_t state = 0;
+    for(size_t i = begin; i < end; ++i) {
+        state = g->dfa[(size_t)state*256 + bytes[i]];
+        if(state == GLOB_DFA_MATCH) return i + 1;
+    }
+    return BTK_SV_NPOS;
+}
+
+#ifdef NOTGREP_JIT
+// A state that goes to at most this many other states is a chain of compares, one that goes to more is a jump table
+#define JIT_MAX_COMPARES 8
+
+typedef struct JitFixup {
+    size_t at;
+    uint32_t label;
+    bool absolute; // A jump table entry, otherwise it's a rel32 of a jump
+} JitFixup;
+
+typedef struct JitBuffer {
+    unsigned char *code;
+    size_t count;
+    size_t capacity;
+    size_t *labels;
+    JitFixup *fixups;
+    size_t fixup_count;
+} JitBuffer;
+
+void jit_emit(JitBuffer *jb, const char *bytes, size_t count)
+{
+    assert(jb->count + count <= jb->capacity && "The JIT code is bigger than its estimate");
+    memcpy(jb->code + jb->count, bytes, count);
+    jb->count += count;
+}
+
+void jit_emit_u32(JitBuffer *jb, uint32_t value)
+{
+    unsigned char bytes[4] = { value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF };
+    jit_emit(jb, (const char *)bytes, 4);
+}
+
+// Emit an instruction that ends with a rel32 to a label, it's resolved once everything is emitted
+void jit_emit_rel32(JitBuffer *jb, const char *opcode, size_t opcode_count, uint32_t label)
+{
+    jit_emit(jb, opcode, opcode_count);
+    jb->fixups[jb->fixup_count++] = (JitFixup){ .at = jb->count, .label = label };
+    jit_emit_u32(jb, 0);
+}
+
+void jit_align(JitBuffer *jb, size_t alignment)
+{
+    while(jb->count % alignment != 0) jit_emit(jb, "\xCC", 1);
+}
+
+// The distinct next states of a state, the state itself is the first one if it loops. `classes` maps every byte
+// to the index of its next state
+// This function returns size_t which is the number of next states, 0 if there are too many for a byte
+size_t jit_state_targets(const uint16_t *row, uint16_t self, uint16_t *targets, unsigned char *classes)
+{
+    size_t count = 0;
+    for(int ch = 0; ch < 256; ++ch) {
+        if(row[ch] == self) {
+            targets[count++] = self;
+            break;
+        }
+    }
+    for(int ch = 0; ch < 256; ++ch) {
+        size_t k = 0;
+        while(k < count && targets[k] != row[ch]) k += 1;
+        if(k == count) {
+            if(count == 256) return 0;
+            targets[count++] = row[ch];
+        }
+        classes[ch] = (unsigned char)k;
+    }
+    return count;
+}
+
+// Compile the DFA to x86-64 code with a block of code for every state, so the state is where the code is and
+// the next byte doesn't wait for the state to be loaded. It's called as `size_t scan(const char *data, size_t begin,
+// size_t end)` with the System V calling convention (rdi, rsi, rdx) and returns the same as glob_dfa_scan().
+// A block looks the byte up in the 256 byte class table of its state, loops right there while the state stays the
+// same and otherwise jumps to the block of the next state through a chain of compares or a jump table
+// This function returns bool which is false if there's no executable memory or a state has too many next states
+bool glob_compile_jit(GlobPattern *g)
+{
+    size_t states = g->dfa_states;
+    uint32_t label_found = (uint32_t)states;
+    uint32_t label_not_found = (uint32_t)states + 1;
+    uint32_t label_classes = (uint32_t)states + 2;
+    uint32_t label_tables = (uint32_t)states + 3; // A jump table for every state that needs one
+    uint16_t (*targets)[256] = malloc(states*sizeof(*targets));
+    size_t *target_counts = malloc(states*sizeof(size_t));
+    unsigned char *classes = malloc(states*256);
+    if(targets == NULL || target_counts == NULL || classes == NULL) {
+        free(targets);
+        free(target_counts);
+        free(classes);
+        return false;
+    }
+    size_t capacity = 7 + 12 + 64 + states*256;
+    size_t fixup_capacity = 1;
+    bool ok = true;
+    for(size_t s = 0; s < states && ok; ++s) {
+        target_counts[s] = jit_state_targets(g->dfa + s*256, (uint16_t)s, targets[s], classes + s*256);
+        ok = target_counts[s] > 0;
+        capacity += 25 + 8 + 11*target_counts[s] + 5 + 8 + 8*target_counts[s];
+        fixup_capacity += 3 + 2*target_counts[s];
+    }
+
+    JitBuffer jb = {0};
+    jb.capacity = capacity;
+    jb.code = ok ? mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) : MAP_FAILED;
+    jb.labels = malloc((states*2 + 3)*sizeof(size_t));
+    jb.fixups = malloc(fixup_capacity*sizeof(JitFixup));
+    ok = jb.code != MAP_FAILED && jb.labels != NULL && jb.fixups != NULL;
+    if(ok) {
+        jit_emit_rel32(&jb, "\x4C\x8D\x05", 3, label_classes);           // lea r8, [rip + classes]
+        for(size_t s = 0; s < states; ++s) {
+            const uint16_t *next = targets[s];
+            size_t count = target_counts[s];
+            jb.labels[s] = jb.count;
+            jit_emit(&jb, "\x48\x39\xD6", 3);                            // cmp rsi, rdx
+            jit_emit_rel32(&jb, "\x0F\x83", 2, label_not_found);        // jae not_found
+            jit_emit(&jb, "\x0F\xB6\x04\x37", 4);                        // movzx eax, byte [rdi + rsi]
+            jit_emit(&jb, "\x48\xFF\xC6", 3);                            // inc rsi
+            jit_emit(&jb, "\x41\x0F\xB6\x84\x00", 5);                    // movzx eax, byte [r8 + rax + s*256]
+            jit_emit_u32(&jb, (uint32_t)(s*256));
+            size_t k = 0;
+            if(next[0] == s) {
+                jit_emit(&jb, "\x85\xC0", 2);                            // test eax, eax
+                jit_emit_rel32(&jb, "\x0F\x84", 2, (uint32_t)s);        // jz self
+                k = 1;
+            }
+            if(count - k <= JIT_MAX_COMPARES) {
+                for(; k + 1 < count; ++k) {
+                    jit_emit(&jb, "\x3D", 1);                            // cmp eax, k
+                    jit_emit_u32(&jb, (uint32_t)k);
+                    jit_emit_rel32(&jb, "\x0F\x84", 2, next[k] == GLOB_DFA_MATCH ? label_found : next[k]); // je next
+                }
+                uint16_t last = next[count - 1];
+                jit_emit_rel32(&jb, "\xE9", 1, last == GLOB_DFA_MATCH ? label_found : last); // jmp next
+            } else {
+                jit_emit_rel32(&jb, "\x48\x8D\x0D", 3, (uint32_t)(label_tables + s)); // lea rcx, [rip + table]
+                jit_emit(&jb, "\xFF\x24\xC1", 3);                        // jmp [rcx + rax*8]
+            }
+        }
+        jb.labels[label_found] = jb.count;
+        jit_emit(&jb, "\x48\x89\xF0\xC3", 4);                            // mov rax, rsi; ret
+        jb.labels[label_not_found] = jb.count;
+        jit_emit(&jb, "\x48\xC7\xC0\xFF\xFF\xFF\xFF\xC3", 8);            // mov rax, -1; ret
+        for(size_t s = 0; s < states; ++s) {
+            size_t k = targets[s][0] == s ? 1 : 0;
+            if(target_counts[s] - k <= JIT_MAX_COMPARES) continue;
+            jit_align(&jb, 8);
+            jb.labels[label_tables + s] = jb.count;
+            for(size_t t = 0; t < target_counts[s]; ++t) {
+                uint16_t target = targets[s][t];
+                jb.fixups[jb.fixup_count++] = (JitFixup){ .at = jb.count, .label = target == GLOB_DFA_MATCH ? label_found : target, .absolute = true };
+                jit_emit(&jb, "\0\0\0\0\0\0\0\0", 8);
+            }
+        }
+        jit_align(&jb, 64);
+        jb.labels[label_classes] = jb.count;
+        jit_emit(&jb, (const char *)classes, states*256);
+
+        for(size_t i = 0; i < jb.fixup_count; ++i) {
+            JitFixup *fx = &jb.fixups[i];
+            if(fx->absolute) {
+                uint64_t address = (uint64_t)(uintptr_t)(jb.code + jb.labels[fx->label]);
+                memcpy(jb.code + fx->at, &address, sizeof(address));
+            } else {
+                int32_t rel = (int32_t)((int64_t)jb.labels[fx->label] - (int64_t)(fx->at + 4));
+                memcpy(jb.code + fx->at, &rel, sizeof(rel));
+            }
+        }
+        ok = mprotect(jb.code, capacity, PROT_READ | PROT_EXEC) == 0;
+    }
+    free(targets);
+    free(target_counts);
+    free(classes);
+    free(jb.labels);
+    free(jb.fixups);
+    if(!ok) {
+        if(jb.code != MAP_FAILED) munmap(jb.code, capacity);
+        return false;
+    }
+    g->jit_code = jb.code;
+    g->jit_size = capacity;
+    // The code is only reachable as data, so the pointer is copied into a function pointer
+    void *entry = jb.code;
+    memcpy(&g->jit_scan, &entry, sizeof(entry));
+    return true;
+}
+#endif // NOTGREP_JIT
+
+void glob_pattern_free(GlobPattern *g)
+{
+#ifdef NOTGREP_JIT
+    if(g->jit_code != NULL) munmap(g->jit_code, g->jit_size);
+#endif
+    g->jit_code = NULL;
+    g->jit_scan = NULL;
+}
+
+// Run the glob through data[begin..end), a match could start at any byte and a newline starts over
+// This function returns size_t which is where the first match ends or BTK_SV_NPOS
+size_t glob_scan(const GlobPattern *g, btk_stringview_t data, size_t begin, size_t end)
+{
+    if(g->jit_scan != NULL) return g->jit_scan(data.data, begin, end);
+    if(g->dfa != NULL) return glob_dfa_scan(g, data, begin, end);
+    uint64_t accept = 1ull << (g->count - 1);
+    uint64_t state = 0;
+    for(size_t i = begin; i < end; ++i) {
+        unsigned char ch = (unsigned char)data.data[i];
+        if(ch == '\n') {
+            state = 0;
+            continue;
+        }
+        state = (((state << 1) | 1) & g->masks[ch]) | (state & g->stars);
+        if(state & accept) return i + 1;
+    }
+    return BTK_SV_NPOS;
+}
+
+// Run the glob backward from the end of a match, down to `lowest` or the start of the line
+// This function returns size_t which is the leftmost start of a match that ends at `end`
+size_t glob_match_start(const GlobPattern *g, btk_stringview_t data, size_t lowest, size_t end)
+{
+    uint64_t accept = 1ull << (g->count - 1);
+    uint64_t state = 0;
+    size_t start = end;
+    for(size_t j = end; j > lowest && data.data[j - 1] != '\n' && (j == end || state != 0); --j) {
+        unsigned char ch = (unsigned char)data.data[j - 1];
+        state = (((state << 1) | (j == end ? 1 : 0)) & g->masks_reversed[ch]) | (state & g->stars_reversed);
+        if(state & accept) start = j - 1;
+    }
+    assert(start < end && "The start of a glob match is not found");
+    return start;
+}
+
+// Find the first match that starts from `from`, it's the one that ends first. Without a literal to search for the
+// glob is run through everything
+// This function returns size_t which is the offset of the match in `data` or BTK_SV_NPOS
+size_t glob_find(const GlobPattern *g, btk_stringview_t data, size_t from, size_t *match_len)
+{
+    while(from <= data.count) {
+        size_t begin = from;
+        size_t end = data.count;
+        if(g->literal.count > 0) {
+            size_t found = g->find_literal(btk_sv_slice(data, from, data.count), g->literal);
+            if(found == BTK_SV_NPOS) return BTK_SV_NPOS;
+            // The lines before the one with the literal can't have a match
+            size_t at = from + found;
+            size_t line_start = btk_sv_rfind_byte(btk_sv_slice(data, from, at), '\n');
+            size_t line_end = btk_sv_find_byte(btk_sv_slice(data, at, data.count), '\n');
+            begin = line_start == BTK_SV_NPOS ? from : from + line_start + 1;
+            end = line_end == BTK_SV_NPOS ? data.count : at + line_end;
+        }
+        size_t match_end = glob_scan(g, data, begin, end);
+        if(match_end != BTK_SV_NPOS) {
+            size_t start = glob_match_start(g, data, begin, match_end);
+            *match_len = match_end - start;
+            return start;
+        }
+        if(g->literal.count == 0 || end == data.count) return BTK_SV_NPOS;
+        from = end + 1;
+    }
+    return BTK_SV_NPOS;
+}
+
+///////////////////////////////////////////
+///
+/// Result cache
+///
+
+// The cache is a file mapped into memory: a header, a hash table of the searched files and a heap with their
+// matches. A file is known by its device and inode, and it's only served from the cache while its size and its
+// modification time are the same. A quarter of the file is the table and the rest is the heap
+#define CACHE_MAGIC 0x3143474eu // "NGC1"
+#define CACHE_MIN_SIZE (64*1024)
+// A file with more matches than this is searched every time, its records would push everything else out
+#define CACHE_MAX_RECORDS_PER_FILE 1024
+
+typedef struct CacheHeader {
+    uint32_t magic;
+    uint32_t slot_size; // sizeof(CacheSlot), so the cache of another build isn't misread
+    uint64_t size;
+    uint64_t slot_count;
+    uint64_t heap_offset;
+    uint64_t heap_used;
+    uint64_t clock; // Ticks on every lookup and store, it's how old the entries are
+    uint64_t live;
+} CacheHeader;
+
+typedef struct CacheSlot {
+    uint64_t key; // 0 if the slot is empty
+    uint64_t pattern_key;
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime_ns;
+    uint64_t last_used;
+    uint64_t records; // Offset of the records in the heap
+    uint32_t record_count; // 0 if the file has no match
+    uint32_t reserved;
+} CacheSlot;
+
+// A match without its preview, the preview is read from the file again
+typedef struct CacheRecord {
+    uint64_t row;
+    uint64_t col; // In bytes, the column in characters is counted again from the preview
+    uint64_t offset;
+    uint64_t line_offset;
+    uint64_t preview_offset;
+    uint32_t len;
+    uint32_t preview_len;
+} CacheRecord;
+
+struct ng_cache {
+    btkfs_shared_file_t file;
+    btk_mutex_t mutex; // The searchers of every thread share the cache
+};
+
+static inline CacheHeader *cache_header(const ng_cache_t *c) { return (CacheHeader *)c->file.data; }
+static inline CacheSlot *cache_slots(const ng_cache_t *c) { return (CacheSlot *)(c->file.data + sizeof(CacheHeader)); }
+static inline char *cache_heap(const ng_cache_t *c) { return c->file.data + cache_header(c)->heap_offset; }
+
+uint64_t cache_mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value;
+    hash *= 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 33);
+}
+
+uint64_t cache_file_key(uint64_t pattern_key, const btkfs_file_id_t *id)
+{
+    uint64_t key = cache_mix(cache_mix(pattern_key, id->device), id->inode);
+    return key != 0 ? key : 1;
+}
+
+void cache_reset(ng_cache_t *c)
+{
+    CacheHeader *h = cache_header(c);
+    uint64_t slot_count = (c->file.size/4 - sizeof(CacheHeader))/sizeof(CacheSlot);
+    *h = (CacheHeader){
+        .magic = CACHE_MAGIC,
+        .slot_size = sizeof(CacheSlot),
+        .size = c->file.size,
+        .slot_count = slot_count,
+        .heap_offset = sizeof(CacheHeader) + slot_count*sizeof(CacheSlot),
+    };
+    memset(cache_slots(c), 0, slot_count*sizeof(CacheSlot));
+}
+
+// A cache written by another build or with another size is started over
+bool cache_is_valid(const ng_cache_t *c)
+{
+    const CacheHeader *h = cache_header(c);
+    return h->magic == CACHE_MAGIC && h->slot_size == sizeof(CacheSlot) && h->size == c->file.size && h->slot_count > 0
+        && h->heap_offset == sizeof(CacheHeader) + h->slot_count*sizeof(CacheSlot) && h->heap_offset < h->size
+        && h->heap_used <= h->size - h->heap_offset && h->live < h->slot_count;
+}
+
+bool cache_slot_is_valid(const ng_cache_t *c, const CacheSlot *slot)
+{
+    uint64_t heap_used = cache_header(c)->heap_used;
+    return slot->record_count <= CACHE_MAX_RECORDS_PER_FILE && slot->records <= heap_used
+        && slot->record_count*sizeof(CacheRecord) <= heap_used - slot->records;
+}
+
+// Returned by cache_probe() when the table has no empty slot, which only happens to a corrupted cache file
+#define CACHE_PROBE_CORRUPTED SIZE_MAX
+
+// The table is never more than 3/4 full, so there's always an empty slot to stop at unless the file is corrupted
+// (i.e. a torn write), the probe is bounded by the slot count so it doesn't spin forever then
+// This function returns size_t which is the slot of the file, the empty slot where it goes or CACHE_PROBE_CORRUPTED
+size_t cache_probe(const ng_cache_t *c, uint64_t key, uint64_t pattern_key, const btkfs_file_id_t *id)
+{
+    const CacheHeader *h = cache_header(c);
+    const CacheSlot *slots = cache_slots(c);
+    size_t i = (size_t)(key % h->slot_count);
+    for(uint64_t step = 0; step < h->slot_count; ++step) {
+        const CacheSlot *slot = &slots[i];
+        if(slot->key == 0) return i;
+        if(slot->key == key && slot->pattern_key == pattern_key && slot->device == id->device && slot->inode == id->inode) return i;
+        i = (i + 1) % h->slot_count;
+    }
+    return CACHE_PROBE_CORRUPTED;
+}
+
+int cache_slot_compare_last_used(const void *a, const void *b)
+{
+    uint64_t x = ((const CacheSlot *)a)->last_used;
+    uint64_t y = ((const CacheSlot *)b)->last_used;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+int cache_slot_compare_records(const void *a, const void *b)
+{
+    uint64_t x = ((const CacheSlot *)a)->records;
+    uint64_t y = ((const CacheSlot *)b)->records;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Drop the least recently used entries until the table and the heap are at most half full. The kept records are
+// moved to the start of the heap and the kept entries are put in the table again, so there's no tombstones
+void cache_evict(ng_cache_t *c)
+{
+    CacheHeader *h = cache_header(c);
+    CacheSlot *slots = cache_slots(c);
+    CacheSlot *kept = malloc((size_t)h->live*sizeof(CacheSlot) + 1);
+    if(kept == NULL) {
+        cache_reset(c);
+        return;
+    }
+    size_t count = 0;
+    for(size_t i = 0; i < h->slot_count && count < h->live; ++i) {
+        if(slots[i].key != 0 && cache_slot_is_valid(c, &slots[i])) kept[count++] = slots[i];
+    }
+    qsort(kept, count, sizeof(CacheSlot), cache_slot_compare_last_used);
+    uint64_t heap_budget = (h->size - h->heap_offset)/2;
+    uint64_t heap_kept = 0;
+    size_t kept_count = 0;
+    for(; kept_count < count && kept_count < h->slot_count*3/8; ++kept_count) {
+        uint64_t bytes = kept[kept_count].record_count*sizeof(CacheRecord);
+        if(heap_kept + bytes > heap_budget) break;
+        heap_kept += bytes;
+    }
+
+    // Moving them in the order they're in the heap never overwrites a record that's not moved yet
+    qsort(kept, kept_count, sizeof(CacheSlot), cache_slot_compare_records);
+    memset(slots, 0, (size_t)h->slot_count*sizeof(CacheSlot));
+    char *heap = cache_heap(c);
+    h->heap_used = 0;
+    for(size_t i = 0; i < kept_count; ++i) {
+        CacheSlot slot = kept[i];
+        size_t bytes = slot.record_count*sizeof(CacheRecord);
+        memmove(heap + h->heap_used, heap + slot.records, bytes);
+        slot.records = h->heap_used;
+        h->heap_used += bytes;
+        btkfs_file_id_t id = { .device = slot.device, .inode = slot.inode };
+        size_t at = cache_probe(c, slot.key, slot.pattern_key, &id);
+        assert(at != CACHE_PROBE_CORRUPTED && "The table is at most 3/8 full after an eviction");
+        slots[at] = slot;
+    }
+    h->live = kept_count;
+    free(kept);
+}
+
+// The records are copied into `a`, the mapping could be changed by another thread as soon as it's unlocked
+// This function returns bool which is true if the file is in the cache with the same size and modification time
+bool cache_lookup(ng_cache_t *c, uint64_t pattern_key, const btkfs_file_id_t *id, btk_arena_t *a, CacheRecord **records, size_t *count)
+{
+    btk_mutex_lock(&c->mutex);
+    CacheHeader *h = cache_header(c);
+    size_t i = cache_probe(c, cache_file_key(pattern_key, id), pattern_key, id);
+    if(i == CACHE_PROBE_CORRUPTED) {
+        cache_reset(c);
+        btk_mutex_unlock(&c->mutex);
+        return false;
+    }
+    CacheSlot *slot = &cache_slots(c)[i];
+    bool found = slot->key != 0 && slot->size == id->size && slot->mtime_ns == id->mtime_ns && cache_slot_is_valid(c, slot);
+    if(found) {
+        slot->last_used = ++h->clock;
+        *count = slot->record_count;
+        *records = NULL;
+        if(slot->record_count > 0) {
+            *records = btk_arena_alloc(a, slot->record_count*sizeof(CacheRecord));
+            memcpy(*records, cache_heap(c) + slot->records, slot->record_count*sizeof(CacheRecord));
+        }
+    }
+    btk_mutex_unlock(&c->mutex);
+    return found;
+}
+
+// An entry of a file that changed is overwritten, its old records are left in the heap until the next eviction
+void cache_store(ng_cache_t *c, uint64_t pattern_key, const btkfs_file_id_t *id, const CacheRecord *records, size_t count)
+{
+    btk_mutex_lock(&c->mutex);
+    CacheHeader *h = cache_header(c);
+    size_t bytes = count*sizeof(CacheRecord);
+    uint64_t heap_capacity = h->size - h->heap_offset;
+    if(count <= CACHE_MAX_RECORDS_PER_FILE && bytes <= heap_capacity/4) {
+        uint64_t key = cache_file_key(pattern_key, id);
+        size_t i = cache_probe(c, key, pattern_key, id);
+        if(i == CACHE_PROBE_CORRUPTED) {
+            cache_reset(c);
+            i = cache_probe(c, key, pattern_key, id);
+        }
+        bool table_full = cache_slots(c)[i].key == 0 && (h->live + 1)*4 > h->slot_count*3;
+        if(table_full || h->heap_used + bytes > heap_capacity) {
+            cache_evict(c);
+            i = cache_probe(c, key, pattern_key, id);
+        }
+        CacheSlot *slot = &cache_slots(c)[i];
+        if(slot->key == 0) h->live += 1;
+        *slot = (CacheSlot){
+            .key = key,
+            .pattern_key = pattern_key,
+            .device = id->device,
+            .inode = id->inode,
+            .size = id->size,
+            .mtime_ns = id->mtime_ns,
+            .last_used = ++h->clock,
+            .records = h->heap_used,
+            .record_count = (uint32_t)count,
+        };
+        if(bytes > 0) memcpy(cache_heap(c) + h->heap_used, records, bytes);
+        h->heap_used += bytes;
+    }
+    btk_mutex_unlock(&c->mutex);
+}
+
+///////////////////////////////////////////
+///
+/// Grep Logics
+///
+
+typedef struct SearchResult {
+    uint64_t row;
+    uint64_t col;
+    uint64_t offset; // Byte offset of the match from the start of the file
+    uint64_t line_offset; // Byte offset of the line containing the match
+    size_t len;
+    uint64_t preview_offset; // Byte offset of the preview, it's only a part of the line if the line is too long
+    btk_stringview_t preview;
+} SearchResult;
+
+// Pattern of bytes given as hex digits where a '?' digit matches any nibble, i.e. "DE ?? BE EF"
+typedef struct BytePattern {
+    unsigned char *bytes;
+    unsigned char *masks;
+    size_t count;
+    // The longest run of fully known bytes, it's searched first then the rest is checked around it
+    size_t anchor_offset;
+    size_t anchor_count;
+} BytePattern;
+
+// Files at least this big are split into chunks that are scanned by multiple threads
+#define CHUNKED_SCAN_THRESHOLD (64ull*1024*1024)
+// Prefetching costs an extra open, advice and close for every file, it's only worth it for a cold page cache
+#define DEFAULT_PREFETCH_DEPTH 0
+#define DROP_CACHE_THRESHOLD (256ull*1024*1024)
+// Remembers the recently prefetched files, so the stats know which searched files were prefetched
+#define PREFETCH_HISTORY_SIZE 64
+// Only the start of a file is checked for being in the page cache
+#define PREFETCH_HIT_CHECK_SIZE (256*1024)
+// Size of the window a file or a pipe is read through. It's refilled with reads of up to its size, big reads
+// are what makes pipes fast
+#define STREAM_WINDOW_SIZE (256*1024)
+// A longer line isn't kept as a whole, so the previews of its matches are cut from around the match
+#define STREAM_LONG_LINE_SIZE (64*1024)
+
+// A file or a directory found by the directory search. Only the name is kept, the full path is made by
+// following the parents up to the searched directory and only for the files that have something to deliver
+typedef struct PathNode {
+    uint32_t parent;
+    uint32_t name_len;
+    const char *name;
+    bool is_dir;
+} PathNode;
+#define PATH_NODE_NONE UINT32_MAX
+
+typedef enum PatternBoundary {
+    BOUNDARY_NONE = 0,
+    BOUNDARY_WORD, // -w, the bytes around the match are not word bytes
+    BOUNDARY_LINE, // -x, the match is the whole line
+} PatternBoundary;
+
+// Compiled once and only read afterwards, so it's shared by the searchers of every thread
+struct ng_pattern {
+    btk_arena_t arena;
+    btk_stringview_t text;
+    LiteralFindFn find_literal;
+    bool bytes_mode;
+    BytePattern byte_pattern;
+    PatternBoundary boundary;
+    // Letters, digits, '_' and every byte of a non ASCII UTF-8 character
+    bool word_bytes[256];
+    bool fuzzy; // --fuzzy, the pattern is matched with up to `fuzzy_pattern.max_errors` edits
+    FuzzyPattern fuzzy_pattern;
+    bool glob;
+    GlobPattern glob_pattern;
+    uint64_t cache_key; // Hash of everything that changes what's matched, the results are cached by it
+    // Hashes of the grams of the bytes that every match has, for the Bloom filters
+    uint64_t *gram_hashes;
+    size_t gram_count;
+};
+
+struct ng_searcher {
+    const ng_pattern_t *pattern;
+    btk_arena_t in_life;
+    btk_arena_t in_file;
+    btk_arena_t in_dir;
+    btk_arena_t in_results; // Previews of the results that are not delivered yet
+    uint64_t find_count;
+    int thread_count;
+    uint64_t chunk_threshold;
+    size_t before_context;
+    size_t after_context;
+    int prefetch_depth;
+    uint64_t drop_cache_threshold;
+    bool collect_stats;
+    bool invert_match;
+    ng_cache_t *cache; // NULL if the results are not cached
+    const ng_bloom_t *bloom; // NULL if the files are not skipped by their Bloom filters
+    // Only the matches from `first_row` to `last_row` (UINT64_MAX for the end of the file) are delivered
+    bool row_range;
+    uint64_t first_row;
+    uint64_t last_row;
+    ng_stats_t stats;
+    uint64_t prefetch_history[PREFETCH_HISTORY_SIZE];
+    size_t prefetch_history_count;
+    ng_match_fn on_match;
+    void *user;
+    bool stopped;
+
+    char *readbuf;
+    size_t readbufsz;
+    // The file being searched. The directory search opens it by its name inside the opened directory, so its
+    // full path is only made when it's asked for
+    struct {
+        int dirfd; // -1 if it's opened by its path
+        uint32_t node;
+        btk_stringview_t path; // Not made yet if it's BTK_SV_NULL
+    } file;
+    struct {
+        PathNode *items;
+        size_t count;
+        size_t capacity;
+    } paths;
+    char *pathbuf;
+    size_t pathbufsz;
+    // The results waiting for their preview before they're delivered
+    struct {
+        SearchResult *items;
+        size_t count;
+        size_t capacity;
+    } results;
+    // The matches delivered for the file being searched, they're stored in the result cache afterwards. Only the
+    // first CACHE_MAX_RECORDS_PER_FILE are kept but all of them are counted
+    struct {
+        CacheRecord *items;
+        size_t count;
+        bool offsets_valid; // False if the searched bytes are not the bytes of the file, i.e. it's compressed
+        bool skipped; // The file isn't searched at all, it's searched again next time
+    } cached;
+};
+typedef struct ng_searcher SearchContext;
+
+uint32_t sc_push_path(SearchContext *sc, uint32_t parent, const char *name, size_t name_len, bool is_dir)
+{
+    assert(sc && "Invalid sc pointer");
+    assert(sc->paths.count < PATH_NODE_NONE && "Too many paths");
+    if(sc->paths.count >= sc->paths.capacity) {
+        sc->paths.capacity = sc->paths.capacity == 0 ? 1024 : sc->paths.capacity*2;
+        PathNode *new_items = btk_arena_alloc(&sc->in_dir, sc->paths.capacity*sizeof(PathNode));
+        if(sc->paths.count > 0) memcpy(new_items, sc->paths.items, sc->paths.count*sizeof(PathNode));
+        sc->paths.items = new_items;
+    }
+    sc->paths.items[sc->paths.count] = (PathNode){
+        .parent = parent,
+        .name_len = (uint32_t)name_len,
+        .name = btk_arena_bufdup(&sc->in_dir, name, name_len + 1),
+        .is_dir = is_dir,
+    };
+    return (uint32_t)sc->paths.count++;
+}
+
+// A name is joined to its parent with a separator unless the parent is the searched directory that ends with
+// one already, same as btkfs_path_join()
+bool path_node_has_separator(const SearchContext *sc, const PathNode *pn)
+{
+    if(pn->parent == PATH_NODE_NONE) return false;
+    const PathNode *parent = &sc->paths.items[pn->parent];
+    return !(parent->parent == PATH_NODE_NONE && parent->name_len > 0 && parent->name[parent->name_len - 1] == BTKFS_PATHSEP);
+}
+
+// Make the full path of a node into the path buffer, it's valid until the next time a path is made
+btk_stringview_t sc_node_path(SearchContext *sc, uint32_t node)
+{
+    assert(sc && "Invalid sc pointer");
+    size_t len = 0;
+    for(uint32_t i = node; i != PATH_NODE_NONE; i = sc->paths.items[i].parent) {
+        const PathNode *pn = &sc->paths.items[i];
+        len += pn->name_len + (path_node_has_separator(sc, pn) ? 1 : 0);
+    }
+    if(len + 1 > sc->pathbufsz) {
+        while(len + 1 > sc->pathbufsz) sc->pathbufsz = sc->pathbufsz == 0 ? 256 : sc->pathbufsz*2;
+        sc->pathbuf = btk_arena_alloc(&sc->in_life, sc->pathbufsz);
+    }
+    // The path is written backward from the node up to the searched directory
+    size_t end = len;
+    sc->pathbuf[end] = 0;
+    for(uint32_t i = node; i != PATH_NODE_NONE; i = sc->paths.items[i].parent) {
+        const PathNode *pn = &sc->paths.items[i];
+        end -= pn->name_len;
+        memcpy(sc->pathbuf + end, pn->name, pn->name_len);
+        if(path_node_has_separator(sc, pn)) sc->pathbuf[--end] = BTKFS_PATHSEP;
+    }
+    return btk_sv_from_parts(sc->pathbuf, len);
+}
+
+// The full path of the file being searched
+btk_stringview_t sc_file_path(SearchContext *sc)
+{
+    assert(sc && "Invalid sc pointer");
+    if(sc->file.path.data == NULL) sc->file.path = sc_node_path(sc, sc->file.node);
+    return sc->file.path;
+}
+
+bool sc_get_file_id(SearchContext *sc, btkfs_file_id_t *id)
+{
+    if(sc->file.dirfd >= 0) return btkfs_get_file_id_at(id, sc->file.dirfd, sc->paths.items[sc->file.node].name) == 0;
+    return btkfs_get_file_id(id, sc_file_path(sc).data) == 0;
+}
+
+void sc_set_file_path(SearchContext *sc, const char *filepath)
+{
+    sc->file.dirfd = -1;
+    sc->file.node = PATH_NODE_NONE;
+    sc->file.path = btk_sv_from_cstr(filepath);
+}
+
+void sc_set_file_node(SearchContext *sc, int dirfd, uint32_t node)
+{
+    sc->file.dirfd = dirfd;
+    sc->file.node = node;
+    sc->file.path = BTK_SV_NULL;
+}
+
+int sc_open_file(SearchContext *sc)
+{
+    if(sc->file.dirfd >= 0) return btkfs_open_file_at(sc->file.dirfd, sc->paths.items[sc->file.node].name);
+    return btkfs_open_file(sc_file_path(sc).data);
+}
+
+void sc_append(SearchContext *sc, SearchResult res)
+{
+    assert(sc && "Invalid sc pointer");
+    if(sc->results.count >= sc->results.capacity) {
+        sc->results.capacity = sc->results.capacity == 0 ? 1024 : sc->results.capacity*2;
+        SearchResult *new_items = btk_arena_alloc(&sc->in_life, sc->results.capacity*sizeof(SearchResult));
+        if(sc->results.count > 0) memcpy(new_items, sc->results.items, sc->results.count*sizeof(SearchResult));
+        sc->results.items = new_items;
+    }
+    sc->results.items[sc->results.count++] = res;
+}
+
+// Hand a record to the callback. Once the callback asks to stop nothing is delivered anymore
+void sc_emit(SearchContext *sc, ng_record_kind_t kind, SearchResult res)
+{
+    assert(sc && "Invalid sc pointer");
+    if(sc->stopped) return;
+    // Only a plain file is searched from its first row in the range, the others are searched as a whole
+    if(kind == NG_RECORD_MATCH && sc->row_range && (res.row < sc->first_row || res.row > sc->last_row)) {
+        sc->find_count -= 1;
+        return;
+    }
+    btk_stringview_t path = sc_file_path(sc);
+    // The column is counted in characters, it needs the line from its start up to the match
+    uint64_t col = res.col;
+    if(kind == NG_RECORD_MATCH && !sc->pattern->bytes_mode && res.preview_offset == res.line_offset && res.col <= res.preview.count) {
+        col = utf8_column(res.preview.data, (size_t)res.col);
+    }
+    if(kind == NG_RECORD_MATCH && sc->cache != NULL && sc->cached.count++ < CACHE_MAX_RECORDS_PER_FILE) {
+        sc->cached.items[sc->cached.count - 1] = (CacheRecord){
+            .row = res.row,
+            .col = res.col,
+            .offset = res.offset,
+            .line_offset = res.line_offset,
+            .preview_offset = res.preview_offset,
+            .len = (uint32_t)res.len,
+            .preview_len = (uint32_t)res.preview.count,
+        };
+    }
+    ng_match_t match = {
+        .kind = kind,
+        .path = path.data,
+        .path_len = path.count,
+        .row = res.row,
+        .col = col,
+        .offset = res.offset,
+        .line_offset = res.line_offset,
+        .len = res.len,
+        .preview_offset = res.preview_offset,
+        .preview = res.preview.data,
+        .preview_len = res.preview.count,
+    };
+    if(sc->on_match(sc->user, &match) != 0) sc->stopped = true;
+}
+
+// Deliver the first `count` results, the rest don't have their preview yet so they're kept for later
+void sc_deliver(SearchContext *sc, size_t count)
+{
+    assert(sc && "Invalid sc pointer");
+    assert(count <= sc->results.count && "Delivering more results than there are");
+    for(size_t i = 0; i < count; ++i) {
+        sc_emit(sc, NG_RECORD_MATCH, sc->results.items[i]);
+    }
+    sc->results.count -= count;
+    memmove(sc->results.items, sc->results.items + count, sc->results.count*sizeof(SearchResult));
+    btk_arena_reset(&sc->in_results);
+}
+
+// How many bytes after the start of a match must be in the buffer to tell if it's a match, minus one. The scanners
+// keep that many bytes when a buffer is refilled or split. A boundary needs the byte after the match too
+size_t pattern_lookahead(const ng_pattern_t *pattern)
+{
+    size_t lookahead = pattern->text.count > 0 ? pattern->text.count - 1 : 0;
+    // A fuzzy match could be longer than the pattern, and one more byte tells if the match could end later
+    if(pattern->fuzzy) lookahead = pattern->text.count + pattern->fuzzy_pattern.max_errors;
+    if(pattern->glob) lookahead = glob_has_stars(&pattern->glob_pattern) ? GLOB_STAR_LOOKAHEAD : pattern->glob_pattern.count - 1;
+    return pattern->boundary != BOUNDARY_NONE ? lookahead + 1 : lookahead;
+}
+
+// `before` and `after` are the bytes around a match, -1 if it's the start or the end of the data
+bool pattern_has_boundaries(const ng_pattern_t *pattern, int before, int after)
+{
+    if(pattern->boundary == BOUNDARY_LINE) {
+        return (before < 0 || before == '\n') && (after < 0 || after == '\n');
+    }
+    return (before < 0 || !pattern->word_bytes[before]) && (after < 0 || !pattern->word_bytes[after]);
+}
+
+// TODO(bagasjs): Regex searching
+// Find the first match of the pattern in `data` starting from `from`. This is the only place that knows how the
+// pattern is matched. It's called from the scanning threads too, so it must not modify `sc`. With -w/-x the
+// literal, fuzzy or glob search finds the candidates and only the ones with boundaries around them are taken, `before` is the
+// byte before data[0] or -1 if it's the start of the data
+// This function returns size_t which is the offset of the match in `data` or BTK_SV_NPOS
+size_t find_pattern(const SearchContext *sc, btk_stringview_t data, size_t from, int before, size_t *match_len)
+{
+    const ng_pattern_t *pattern = sc->pattern;
+    *match_len = pattern->text.count;
+    while(from <= data.count) {
+        size_t pos;
+        if(pattern->fuzzy) {
+            pos = fuzzy_find(&pattern->fuzzy_pattern, data, from, match_len);
+            if(pos == BTK_SV_NPOS) return BTK_SV_NPOS;
+        } else if(pattern->glob) {
+            pos = glob_find(&pattern->glob_pattern, data, from, match_len);
+            if(pos == BTK_SV_NPOS) return BTK_SV_NPOS;
+        } else {
+            size_t found = pattern->find_literal(btk_sv_slice(data, from, data.count), pattern->text);
+            if(found == BTK_SV_NPOS) return BTK_SV_NPOS;
+            pos = from + found;
+        }
+        if(pattern->boundary == BOUNDARY_NONE) return pos;
+        size_t end = pos + *match_len;
+        int byte_before = pos > 0 ? (unsigned char)data.data[pos - 1] : before;
+        int byte_after = end < data.count ? (unsigned char)data.data[end] : -1;
+        if(pattern_has_boundaries(pattern, byte_before, byte_after)) return pos;
+        from = pos + 1;
+    }
+    return BTK_SV_NPOS;
+}
+
+///////////////////////////////////////////
+///
+/// Streaming scanning
+///
+
+#define LONG_LINE_PREVIEW_CONTEXT 80
+
+// The preview of a match at `at` of a long line, it's only the bytes around the match
+btk_stringview_t cut_line_preview(btk_stringview_t line, size_t at)
+{
+    size_t begin = at > LONG_LINE_PREVIEW_CONTEXT ? at - LONG_LINE_PREVIEW_CONTEXT : 0;
+    size_t end = at + 2*LONG_LINE_PREVIEW_CONTEXT < line.count ? at + 2*LONG_LINE_PREVIEW_CONTEXT : line.count;
+    return btk_sv_slice(line, begin, end);
+}
+
+// The preview of a match at `at` of a whole line. A line longer than STREAM_LONG_LINE_SIZE isn't delivered as a
+// whole, every search cuts it the same way so the output doesn't depend on how the file is read
+btk_stringview_t line_preview(btk_stringview_t line, size_t at)
+{
+    return line.count <= STREAM_LONG_LINE_SIZE ? line : cut_line_preview(line, at);
+}
+
+typedef ng_read_fn StreamReadFn;
+
+typedef struct StreamScanner {
+    SearchContext *sc;
+    char *buf;
+    size_t len;
+    uint64_t base; // Offset of buf[0] from the start of the stream
+    uint64_t row;
+    uint64_t line_start; // Offset of the current line from the start of the stream
+    size_t counted; // Newlines before buf[counted] are already counted
+    size_t pending; // Results starting from this index don't have their preview yet
+    int before; // The byte before buf[0], -1 at the start of the stream
+} StreamScanner;
+
+// Give the pending results their preview. When the whole line is still in the window all of them share
+// a copy of that line, otherwise each one gets only the bytes around its match. The window keeps the bytes before
+// the pending matches of a long line, but the ones after a match near the end of the window are only read later,
+// so those matches wait until the line is complete or the window has their bytes
+void stream_set_previews(StreamScanner *ss, size_t line_end, bool line_complete)
+{
+    SearchContext *sc = ss->sc;
+    if(ss->pending == sc->results.count) return;
+    size_t line_begin = ss->line_start >= ss->base ? (size_t)(ss->line_start - ss->base) : 0;
+    btk_stringview_t line = btk_sv_from_parts(ss->buf + line_begin, line_end - line_begin);
+    bool whole_line = line_complete && ss->line_start >= ss->base && line.count <= STREAM_LONG_LINE_SIZE;
+    btk_stringview_t preview = BTK_SV_NULL;
+    if(whole_line) preview = btk_sv_from_parts(btk_arena_bufdup(&sc->in_results, line.data, line.count), line.count);
+    uint64_t preview_offset = ss->base + line_begin;
+    size_t ready = sc->results.count;
+    for(size_t i = ss->pending; i < sc->results.count; ++i) {
+        SearchResult *res = &sc->results.items[i];
+        if(!whole_line) {
+            size_t at = (size_t)(res->offset - ss->base) - line_begin;
+            if(!line_complete && at + 2*LONG_LINE_PREVIEW_CONTEXT > line.count) {
+                ready = i;
+                break;
+            }
+            btk_stringview_t cut = cut_line_preview(line, at);
+            preview = btk_sv_from_parts(btk_arena_bufdup(&sc->in_results, cut.data, cut.count), cut.count);
+            preview_offset = ss->base + (uint64_t)(cut.data - ss->buf);
+        }
+        res->preview = preview;
+        res->preview_offset = preview_offset;
+    }
+    sc_deliver(sc, ready);
+    ss->pending = 0;
+}
+
+// Count the newlines until buf[upto], the first one ends the line of the pending results
+void stream_count_lines(StreamScanner *ss, size_t upto)
+{
+    if(ss->counted >= upto) return;
+    btk_stringview_t range = btk_sv_from_parts(ss->buf + ss->counted, upto - ss->counted);
+    if(ss->pending != ss->sc->results.count) {
+        size_t newline = btk_sv_find_byte(range, '\n');
+        if(newline == BTK_SV_NPOS) {
+            ss->counted = upto;
+            return;
+        }
+        stream_set_previews(ss, ss->counted + newline, true);
+        ss->row += 1;
+        ss->line_start = ss->base + ss->counted + newline + 1;
+        range = btk_sv_slice(range, newline + 1, range.count);
+    }
+    size_t newlines = btk_sv_count_byte(range, '\n');
+    if(newlines > 0) {
+        ss->row += newlines;
+        ss->line_start = ss->base + (upto - range.count) + btk_sv_rfind_byte(range, '\n') + 1;
+    }
+    ss->counted = upto;
+}
+
+// Deliver the whole lines of buf[begin..end) as one record, without looking at each of them
+// This function returns uint64_t which is the number of newlines in the range
+uint64_t stream_deliver_lines(SearchContext *sc, const char *buf, size_t begin, size_t end, uint64_t base, uint64_t row)
+{
+    if(begin >= end) return 0;
+    btk_stringview_t lines = btk_sv_from_parts(buf + begin, end - begin);
+    uint64_t newlines = btk_sv_count_byte(lines, '\n');
+    sc->find_count += newlines + (buf[end - 1] != '\n' ? 1 : 0);
+    sc_emit(sc, NG_RECORD_LINES, (SearchResult){
+        .row = row,
+        .offset = base + begin,
+        .line_offset = base + begin,
+        .preview_offset = base + begin,
+        .preview = lines,
+    });
+    return newlines;
+}
+
+// Search for the lines without a match (-v). The matches are found over the window the same way as
+// search_in_stream() and the lines between the lines with a match are delivered as one record that points right
+// into the window. A line is only known to be without a match once it's scanned up to its end, so the window
+// grows while the line being decided doesn't fit in it
+void search_in_stream_inverted(SearchContext *sc, size_t filled, StreamReadFn read_fn, void *user)
+{
+    assert(sc && "Invalid sc pointer");
+    assert(filled <= sc->readbufsz && "The window is overfilled");
+    char *buf = sc->readbuf;
+    char *grown = NULL; // The window once it's grown past the read buffer
+    size_t cap = sc->readbufsz;
+    size_t len = filled;
+    size_t overlap = pattern_lookahead(sc->pattern);
+    assert(overlap < cap/2 && "The read buffer is too small for the pattern");
+    uint64_t base = 0; // Offset of buf[0] from the start of the stream
+    uint64_t row = 0;  // Row of the line at buf[gap]
+    size_t gap = 0;    // The lines from here are not delivered yet, it's always at the start of a line
+    size_t cursor = 0;
+    bool in_match = false; // The line at buf[gap] has a match but its end isn't read yet
+    int before = -1;
+    for(;;) {
+        bool full = len == cap;
+        size_t n = full ? 0 : read_fn(user, buf + len, cap - len);
+        bool eof = n == 0 && !full;
+        len += n;
+
+        if(in_match) {
+            size_t newline = btk_sv_find_byte(btk_sv_from_parts(buf + cursor, len - cursor), '\n');
+            if(newline == BTK_SV_NPOS) {
+                gap = cursor = len;
+            } else {
+                gap = cursor = cursor + newline + 1;
+                row += 1;
+                in_match = false;
+            }
+        }
+
+        size_t scan_end = eof ? len : (len > overlap ? len - overlap : 0);
+        while(!in_match && !sc->stopped) {
+            size_t match_len;
+            size_t pos = cursor < scan_end ? find_pattern(sc, btk_sv_from_parts(buf, len), cursor, before, &match_len) : BTK_SV_NPOS;
+            if(pos == BTK_SV_NPOS || pos >= scan_end) {
+                // Every line that ends before scan_end is scanned as a whole and has no match
+                size_t decided = gap;
+                if(eof) {
+                    decided = len;
+                } else if(scan_end > gap) {
+                    size_t last = btk_sv_rfind_byte(btk_sv_from_parts(buf + gap, scan_end - gap), '\n');
+                    if(last != BTK_SV_NPOS) decided = gap + last + 1;
+                }
+                row += stream_deliver_lines(sc, buf, gap, decided, base, row);
+                gap = decided;
+                if(cursor < scan_end) cursor = scan_end;
+                break;
+            }
+            size_t last = btk_sv_rfind_byte(btk_sv_from_parts(buf + gap, pos - gap), '\n');
+            size_t line_start = last == BTK_SV_NPOS ? gap : gap + last + 1;
+            row += stream_deliver_lines(sc, buf, gap, line_start, base, row);
+            gap = line_start;
+            // The rest of the line with the match is skipped, its other matches don't matter
+            size_t newline = btk_sv_find_byte(btk_sv_from_parts(buf + pos, len - pos), '\n');
+            if(newline == BTK_SV_NPOS) {
+                in_match = true;
+                cursor = len;
+                break;
+            }
+            gap = cursor = pos + newline + 1;
+            row += 1;
+        }
+        if(eof || sc->stopped) break;
+
+        size_t keep_from = in_match ? len : gap;
+        if(keep_from > 0) before = (unsigned char)buf[keep_from - 1];
+        memmove(buf, buf + keep_from, len - keep_from);
+        base += keep_from;
+        len -= keep_from;
+        cursor -= keep_from;
+        gap = in_match ? 0 : gap - keep_from;
+        // A line that's still undecided after half of the window is read gets a bigger window, like grep does
+        if(len > cap/2) {
+            char *new_buf = malloc(cap*2);
+            if(new_buf == NULL) {
+                fprintf(stderr, "ERROR: Out of memory for a line of %s\n", sc_file_path(sc).data);
+                break;
+            }
+            memcpy(new_buf, buf, len);
+            free(grown);
+            grown = buf = new_buf;
+            cap *= 2;
+        }
+    }
+    free(grown);
+}
+
+// Search through a fixed size window that's refilled from `read_fn`. The last (pattern length - 1) bytes of the
+// window are kept for the next round so a match crossing the refill is still found. A line could be arbitrarily
+// long (i.e. Javascript bundled source) while the memory stays bounded. The first `filled` bytes of the window
+// are already read by the caller. The stream starts at `offset` of the file which is the start of `row`, both
+// are 0 unless it's a range of rows of the file
+// This function returns uint64_t which is the row at the end of the stream
+uint64_t search_in_stream_from(SearchContext *sc, size_t filled, StreamReadFn read_fn, void *user, uint64_t offset, uint64_t row)
+{
+    assert(sc && "Invalid sc pointer");
+    assert(filled <= sc->readbufsz && "The window is overfilled");
+    StreamScanner ss = {
+        .sc = sc, .buf = sc->readbuf, .len = filled, .base = offset, .row = row, .line_start = offset,
+        .before = offset > 0 ? '\n' : -1, .pending = sc->results.count,
+    };
+    size_t cap = sc->readbufsz;
+    size_t overlap = pattern_lookahead(sc->pattern);
+    assert(overlap < cap/2 && "The read buffer is too small for the pattern");
+    assert(cap/2 >= STREAM_LONG_LINE_SIZE && "The read buffer is too small for a whole line");
+    size_t cursor = 0;
+    for(;;) {
+        // The window is only full when the caller filled it, then it's scanned before anything more is read
+        bool full = ss.len == cap;
+        size_t n = full ? 0 : read_fn(user, ss.buf + ss.len, cap - ss.len);
+        bool eof = n == 0 && !full;
+        ss.len += n;
+
+        // Unless it's the end of the stream, a match may only start where the whole match fits in the window
+        size_t scan_end = eof ? ss.len : (ss.len > overlap ? ss.len - overlap : 0);
+        while(cursor < scan_end && !sc->stopped) {
+            size_t match_len;
+            size_t pos = find_pattern(sc, btk_sv_from_parts(ss.buf, ss.len), cursor, ss.before, &match_len);
+            if(pos == BTK_SV_NPOS || pos >= scan_end) break;
+            stream_count_lines(&ss, pos);
+            sc->find_count += 1;
+            sc_append(sc, (SearchResult){
+                .row = ss.row,
+                .col = ss.base + pos - ss.line_start,
+                .offset = ss.base + pos,
+                .line_offset = ss.line_start,
+                .len = match_len,
+            });
+            cursor = pos + (match_len > 0 ? match_len : 1);
+        }
+        if(cursor < scan_end) cursor = scan_end;
+        stream_count_lines(&ss, cursor);
+        // Deliver the matches as soon as their line is complete, a pipe may not have anything more for a while
+        if(ss.pending != sc->results.count) {
+            size_t newline = btk_sv_find_byte(btk_sv_from_parts(ss.buf + ss.counted, ss.len - ss.counted), '\n');
+            if(newline != BTK_SV_NPOS) stream_set_previews(&ss, ss.counted + newline, true);
+        }
+        if(eof || sc->stopped) break;
+
+        // Keep the current line while it's short so it could still be the preview of its matches, and the bytes
+        // before the next match of a long line otherwise
+        size_t keep_from = cursor;
+        size_t line_begin = ss.line_start >= ss.base ? (size_t)(ss.line_start - ss.base) : 0;
+        if(ss.line_start >= ss.base && ss.len - line_begin <= STREAM_LONG_LINE_SIZE) {
+            keep_from = line_begin;
+        } else {
+            stream_set_previews(&ss, ss.len, false);
+            if(ss.pending != sc->results.count) keep_from = (size_t)(sc->results.items[ss.pending].offset - ss.base);
+            keep_from = keep_from > line_begin + LONG_LINE_PREVIEW_CONTEXT ? keep_from - LONG_LINE_PREVIEW_CONTEXT : line_begin;
+        }
+        if(keep_from > 0) ss.before = (unsigned char)ss.buf[keep_from - 1];
+        memmove(ss.buf, ss.buf + keep_from, ss.len - keep_from);
+        ss.base += keep_from;
+        ss.len -= keep_from;
+        ss.counted -= keep_from;
+        cursor -= keep_from;
+    }
+    // The last line doesn't always end with a newline
+    stream_set_previews(&ss, ss.len, true);
+    return ss.row;
+}
+
+void search_in_stream(SearchContext *sc, size_t filled, StreamReadFn read_fn, void *user)
+{
+    if(sc->invert_match) {
+        search_in_stream_inverted(sc, filled, read_fn, user);
+        return;
+    }
+    search_in_stream_from(sc, filled, read_fn, user, 0, 0);
+}
+
+typedef struct MemoryReader {
+    btk_stringview_t data;
+    size_t at;
+} MemoryReader;
+
+size_t read_from_memory(void *user, char *buf, size_t bufsz)
+{
+    MemoryReader *mr = user;
+    size_t n = mr->data.count - mr->at < bufsz ? mr->data.count - mr->at : bufsz;
+    memcpy(buf, mr->data.data + mr->at, n);
+    mr->at += n;
+    return n;
+}
+
+typedef struct FileReader {
+    int fd;
+    uint64_t total; // Bytes read so far, it's the size of the file once the end is reached
+} FileReader;
+
+size_t read_from_fd(void *user, char *buf, size_t bufsz)
+{
+    FileReader *fr = user;
+    long long n = btkfs_read_file(fr->fd, buf, bufsz);
+    if(n <= 0) return 0;
+    fr->total += (uint64_t)n;
+    return (size_t)n;
+}
+
+// Gives the bytes that were already read from a stream before the rest of it
+typedef struct PrefixedReader {
+    MemoryReader prefix;
+    StreamReadFn read_fn;
+    void *user;
+} PrefixedReader;
+
+size_t read_from_prefixed(void *user, char *buf, size_t bufsz)
+{
+    PrefixedReader *pr = user;
+    if(pr->prefix.at < pr->prefix.data.count) return read_from_memory(&pr->prefix, buf, bufsz);
+    return pr->read_fn(pr->user, buf, bufsz);
+}
+
+// Reads [offset, end) of an opened file without moving its position
+typedef struct RangeReader {
+    int fd;
+    uint64_t offset;
+    uint64_t end;
+} RangeReader;
+
+size_t read_from_range(void *user, char *buf, size_t bufsz)
+{
+    RangeReader *rr = user;
+    if(rr->offset >= rr->end) return 0;
+    if(bufsz > rr->end - rr->offset) bufsz = (size_t)(rr->end - rr->offset);
+    long long n = btkfs_read_file_at(rr->fd, buf, bufsz, rr->offset);
+    if(n <= 0) return 0;
+    rr->offset += (uint64_t)n;
+    return (size_t)n;
+}
+
+// Read the whole stream into a buffer allocated with malloc(), for the searches that need all of it at once
+// This function returns char* which is NULL if it's out of memory
+char *read_all(StreamReadFn read_fn, void *user, size_t capacity, size_t *count)
+{
+    *count = 0;
+    char *data = malloc(capacity);
+    if(data == NULL) return NULL;
+    size_t n;
+    while((n = read_fn(user, data + *count, capacity - *count)) > 0) {
+        *count += n;
+        if(*count == capacity) {
+            capacity *= 2;
+            char *new_data = realloc(data, capacity);
+            if(new_data == NULL) {
+                free(data);
+                return NULL;
+            }
+            data = new_data;
+        }
+    }
+    return data;
+}
+
+///////////////////////////////////////////
+///
+/// Compressed files
+///
+
+#ifdef NOTGREP_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef NOTGREP_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#define DECOMPRESS_RING_SIZE (1024*1024)
+#define DECOMPRESS_BLOCK_SIZE (64*1024)
+
+typedef enum CompressionKind {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD,
+} CompressionKind;
+
+CompressionKind detect_compression(const unsigned char *magic, size_t count)
+{
+    if(count >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) return COMPRESSION_GZIP;
+    if(count >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) return COMPRESSION_ZSTD;
+    return COMPRESSION_NONE;
+}
+
+// Fixed size buffer between one writer thread and one reader thread. `head` and `tail` are the total bytes
+// that are written and read so far
+typedef struct RingBuffer {
+    char *data;
+    size_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    bool closed;
+    btk_mutex_t mutex;
+    btk_cond_t not_empty;
+    btk_cond_t not_full;
+} RingBuffer;
+
+void ring_init(RingBuffer *ring, char *data, size_t capacity)
+{
+    ring->data = data;
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->closed = false;
+    btk_mutex_init(&ring->mutex);
+    btk_cond_init(&ring->not_empty);
+    btk_cond_init(&ring->not_full);
+}
+
+void ring_destroy(RingBuffer *ring)
+{
+    btk_cond_destroy(&ring->not_full);
+    btk_cond_destroy(&ring->not_empty);
+    btk_mutex_destroy(&ring->mutex);
+}
+
+// Blocks until everything is written. Returns false if the reader closed the ring since nobody wants the rest
+bool ring_write(RingBuffer *ring, const char *data, size_t count)
+{
+    btk_mutex_lock(&ring->mutex);
+    while(count > 0 && !ring->closed) {
+        while(ring->head - ring->tail == ring->capacity && !ring->closed) btk_cond_wait(&ring->not_full, &ring->mutex);
+        if(ring->closed) break;
+        size_t at = (size_t)(ring->head % ring->capacity);
+        size_t space = ring->capacity - (size_t)(ring->head - ring->tail);
+        size_t n = ring->capacity - at < space ? ring->capacity - at : space;
+        if(n > count) n = count;
+        memcpy(ring->data + at, data, n);
+        ring->head += n;
+        data += n;
+        count -= n;
+        btk_cond_signal(&ring->not_empty);
+    }
+    bool written = count == 0;
+    btk_mutex_unlock(&ring->mutex);
+    return written;
+}
+
+// Both sides could close the ring, the writer when it's done and the reader when it stops reading
+void ring_close(RingBuffer *ring)
+{
+    btk_mutex_lock(&ring->mutex);
+    ring->closed = true;
+    btk_cond_signal(&ring->not_empty);
+    btk_cond_signal(&ring->not_full);
+    btk_mutex_unlock(&ring->mutex);
+}
+
+// StreamReadFn of the reading side. Blocks until there's something to read or the writer closed the ring
+size_t ring_read(void *user, char *buf, size_t bufsz)
+{
+    RingBuffer *ring = user;
+    btk_mutex_lock(&ring->mutex);
+    while(ring->head == ring->tail && !ring->closed) btk_cond_wait(&ring->not_empty, &ring->mutex);
+    size_t at = (size_t)(ring->tail % ring->capacity);
+    size_t available = (size_t)(ring->head - ring->tail);
+    size_t n = ring->capacity - at < available ? ring->capacity - at : available;
+    if(n > bufsz) n = bufsz;
+    memcpy(buf, ring->data + at, n);
+    ring->tail += n;
+    btk_cond_signal(&ring->not_full);
+    btk_mutex_unlock(&ring->mutex);
+    return n;
+}
+
+typedef struct Decompressor {
+    CompressionKind kind;
+    StreamReadFn read_fn; // Reads the compressed bytes
+    void *reader;
+    const char *filepath;
+    char *in;
+    char *out;
+    RingBuffer ring;
+    btk_thread_t thread;
+} Decompressor;
+
+#ifdef NOTGREP_WITH_ZLIB
+void decompress_gzip(Decompressor *dc)
+{
+    z_stream zs = {0};
+    // 32 lets zlib detect the gzip header by itself
+    if(inflateInit2(&zs, 15 + 32) != Z_OK) {
+        fprintf(stderr, "ERROR: Could not initialize zlib for %s\n", dc->filepath);
+        return;
+    }
+    int ret = Z_OK;
+    for(;;) {
+        if(zs.avail_in == 0) {
+            zs.avail_in = (uInt)dc->read_fn(dc->reader, dc->in, DECOMPRESS_BLOCK_SIZE);
+            zs.next_in = (Bytef *)dc->in;
+            if(zs.avail_in == 0) break;
+        }
+        zs.next_out = (Bytef *)dc->out;
+        zs.avail_out = DECOMPRESS_BLOCK_SIZE;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) break;
+        if(!ring_write(&dc->ring, dc->out, DECOMPRESS_BLOCK_SIZE - zs.avail_out)) break;
+        // Rotated logs are often several gzip members concatenated together
+        if(ret == Z_STREAM_END) inflateReset(&zs);
+    }
+    if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+        fprintf(stderr, "ERROR: Could not decompress %s: %s\n", dc->filepath, zs.msg ? zs.msg : "corrupted data");
+    }
+    inflateEnd(&zs);
+}
+#endif
+
+#ifdef NOTGREP_WITH_ZSTD
+void decompress_zstd(Decompressor *dc)
+{
+    ZSTD_DStream *ds = ZSTD_createDStream();
+    if(ds == NULL) {
+        fprintf(stderr, "ERROR: Could not initialize zstd for %s\n", dc->filepath);
+        return;
+    }
+    ZSTD_initDStream(ds);
+    ZSTD_inBuffer input = { .src = dc->in, .size = 0, .pos = 0 };
+    for(;;) {
+        if(input.pos == input.size) {
+            input.size = dc->read_fn(dc->reader, dc->in, DECOMPRESS_BLOCK_SIZE);
+            input.pos = 0;
+            if(input.size == 0) break;
+        }
+        ZSTD_outBuffer output = { .dst = dc->out, .size = DECOMPRESS_BLOCK_SIZE, .pos = 0 };
+        size_t ret = ZSTD_decompressStream(ds, &output, &input);
+        if(ZSTD_isError(ret)) {
+            fprintf(stderr, "ERROR: Could not decompress %s: %s\n", dc->filepath, ZSTD_getErrorName(ret));
+            break;
+        }
+        if(!ring_write(&dc->ring, dc->out, output.pos)) break;
+    }
+    ZSTD_freeDStream(ds);
+}
+#endif
+
+// The first stage of the pipeline, the matching thread is reading from the other side of the ring
+void decompress_thread(void *arg)
+{
+    Decompressor *dc = arg;
+    switch(dc->kind) {
+#ifdef NOTGREP_WITH_ZLIB
+        case COMPRESSION_GZIP: decompress_gzip(dc); break;
+#endif
+#ifdef NOTGREP_WITH_ZSTD
+        case COMPRESSION_ZSTD: decompress_zstd(dc); break;
+#endif
+        default: break;
+    }
+    ring_close(&dc->ring);
+}
+
+bool compression_supported(CompressionKind kind)
+{
+    switch(kind) {
+#ifdef NOTGREP_WITH_ZLIB
+        case COMPRESSION_GZIP: return true;
+#endif
+#ifdef NOTGREP_WITH_ZSTD
+        case COMPRESSION_ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+// Search in compressed file
+// The file is decompressed by another thread into a ring buffer while this thread is matching the decompressed
+// data coming out of it, so nothing is ever written to the disk. The offsets and rows are of the decompressed data
+void search_in_compressed_file(SearchContext *sc, StreamReadFn read_fn, void *reader, CompressionKind kind)
+{
+    assert(sc && "Invalid sc pointer");
+    if(!compression_supported(kind)) {
+        fprintf(stderr, "WARNING: Skipping "BTK_SV_FMT", notgrep was built without %s support\n",
+                BTK_SV_ARGV(sc_file_path(sc)), kind == COMPRESSION_GZIP ? "zlib" : "zstd");
+        sc->cached.skipped = true;
+        return;
+    }
+    Decompressor dc = {
+        .kind = kind,
+        .read_fn = read_fn,
+        .reader = reader,
+        .filepath = btk_arena_bufdup(&sc->in_file, sc_file_path(sc).data, sc_file_path(sc).count + 1),
+        .in = btk_arena_alloc(&sc->in_file, DECOMPRESS_BLOCK_SIZE),
+        .out = btk_arena_alloc(&sc->in_file, DECOMPRESS_BLOCK_SIZE),
+    };
+    ring_init(&dc.ring, btk_arena_alloc(&sc->in_file, DECOMPRESS_RING_SIZE), DECOMPRESS_RING_SIZE);
+    if(btk_thread_create(&dc.thread, decompress_thread, &dc) != 0) {
+        fprintf(stderr, "ERROR: Could not start the decompression of %s\n", dc.filepath);
+        ring_destroy(&dc.ring);
+        return;
+    }
+    search_in_stream(sc, 0, ring_read, &dc.ring);
+    if(sc->stopped) ring_close(&dc.ring);
+    btk_thread_join(&dc.thread);
+    ring_destroy(&dc.ring);
+}
+
+///////////////////////////////////////////
+///
+/// Chunked scanning of a single huge file
+///
+
+// How far a chunk boundary may be moved forward to reach a newline. If there's no newline that close the chunk
+// is split in the middle of a line and the overlap window takes care of the matches crossing the boundary
+#define CHUNK_SNAP_LIMIT (1024*1024)
+// Marks a match whose line started in one of the previous chunks, the merging fills in the real line offset
+#define LINE_OFFSET_IN_PREV_CHUNK UINT64_MAX
+
+typedef struct ChunkMatch {
+    uint64_t row; // Relative to the start of the chunk
+    uint64_t offset;
+    uint64_t line_offset;
+    size_t len;
+} ChunkMatch;
+
+typedef struct ScanChunk {
+    const SearchContext *sc;
+    btk_stringview_t data;
+    // Only matches starting inside [begin, end) belong to this chunk
+    size_t begin;
+    size_t end;
+    uint64_t newline_count;
+    size_t last_newline;
+    btk_arena_t arena;
+    btk_thread_t thread;
+    struct {
+        ChunkMatch *items;
+        size_t count;
+        size_t capacity;
+    } matches;
+} ScanChunk;
+
+void chunk_append(ScanChunk *chunk, ChunkMatch match)
+{
+    assert(chunk && "Invalid chunk pointer");
+    if(chunk->matches.count >= chunk->matches.capacity) {
+        chunk->matches.capacity = chunk->matches.capacity == 0 ? 1024 : chunk->matches.capacity*2;
+        ChunkMatch *new_items = btk_arena_alloc(&chunk->arena, chunk->matches.capacity*sizeof(ChunkMatch));
+        if(chunk->matches.count > 0) memcpy(new_items, chunk->matches.items, chunk->matches.count*sizeof(ChunkMatch));
+        chunk->matches.items = new_items;
+    }
+    chunk->matches.items[chunk->matches.count++] = match;
+}
+
+void scan_chunk(void *arg)
+{
+    ScanChunk *chunk = arg;
+    btk_stringview_t data = chunk->data;
+    // The window goes past the end of the chunk so a match that starts inside the chunk but crosses
+    // the boundary is still found
+    size_t overlap = pattern_lookahead(chunk->sc->pattern);
+    btk_stringview_t window = btk_sv_slice(data, 0, chunk->end + overlap);
+
+    bool line_starts_here = chunk->begin == 0 || data.data[chunk->begin - 1] == '\n';
+    uint64_t line_start = line_starts_here ? chunk->begin : LINE_OFFSET_IN_PREV_CHUNK;
+    uint64_t row = 0;
+    size_t counted = chunk->begin;
+    size_t cursor = chunk->begin;
+    while(cursor < chunk->end) {
+        size_t match_len;
+        size_t pos = find_pattern(chunk->sc, window, cursor, -1, &match_len);
+        if(pos == BTK_SV_NPOS || pos >= chunk->end) break;
+
+        btk_stringview_t skipped = btk_sv_slice(data, counted, pos);
+        size_t newlines = btk_sv_count_byte(skipped, '\n');
+        if(newlines > 0) {
+            row += newlines;
+            line_start = counted + btk_sv_rfind_byte(skipped, '\n') + 1;
+        }
+        counted = pos;
+
+        chunk_append(chunk, (ChunkMatch){ .row = row, .offset = pos, .line_offset = line_start, .len = match_len });
+        cursor = pos + (match_len > 0 ? match_len : 1);
+    }
+
+    btk_stringview_t rest = btk_sv_slice(data, counted, chunk->end);
+    chunk->newline_count = row + btk_sv_count_byte(rest, '\n');
+    btk_stringview_t whole = btk_sv_slice(data, chunk->begin, chunk->end);
+    size_t last_newline = btk_sv_rfind_byte(whole, '\n');
+    chunk->last_newline = last_newline == BTK_SV_NPOS ? BTK_SV_NPOS : chunk->begin + last_newline;
+}
+
+// Puts the matches of the chunks together in order, the rows of a chunk are relative to its start
+typedef struct ChunkMerger {
+    SearchContext *sc;
+    btk_stringview_t data;
+    uint64_t row_base;
+    uint64_t line_start;
+    uint64_t prev_match_end;
+    // The line of the last match, a long line could have a lot of matches
+    uint64_t line_offset_of_line;
+    btk_stringview_t line;
+} ChunkMerger;
+
+void chunk_merge_emit(ChunkMerger *m, ChunkMatch match)
+{
+    SearchContext *sc = m->sc;
+    m->prev_match_end = match.offset + match.len;
+    uint64_t line_offset = match.line_offset == LINE_OFFSET_IN_PREV_CHUNK ? m->line_start : match.line_offset;
+    if(line_offset != m->line_offset_of_line) {
+        m->line = btk_sv_slice(m->data, line_offset, m->data.count);
+        size_t newline = btk_sv_find_byte(m->line, '\n');
+        if(newline != BTK_SV_NPOS) m->line.count = newline;
+        m->line_offset_of_line = line_offset;
+    }
+    btk_stringview_t preview = line_preview(m->line, (size_t)(match.offset - line_offset));
+    sc->find_count += 1;
+    sc_emit(sc, NG_RECORD_MATCH, (SearchResult){
+        .row = m->row_base + match.row,
+        .col = match.offset - line_offset,
+        .offset = match.offset,
+        .line_offset = line_offset,
+        .len = match.len,
+        .preview_offset = (uint64_t)(preview.data - m->data.data),
+        .preview = preview,
+    });
+}
+
+// The last match of the previous chunk ended inside this one, so a single thread would have searched this chunk
+// from the end of that match and not from its start (only possible when the boundary couldn't be moved to a
+// newline). The matches are searched again from there until one of them is one that the chunk found too, from
+// then on they're the same
+// This function returns size_t which is the index of the first match of the chunk that's still to be delivered
+size_t chunk_resync(ChunkMerger *m, ScanChunk *chunk)
+{
+    SearchContext *sc = m->sc;
+    size_t overlap = pattern_lookahead(sc->pattern);
+    size_t window_end = chunk->end + overlap < m->data.count ? chunk->end + overlap : m->data.count;
+    btk_stringview_t window = btk_sv_slice(m->data, 0, window_end);
+    bool line_starts_here = chunk->begin == 0 || m->data.data[chunk->begin - 1] == '\n';
+    uint64_t line_start = line_starts_here ? chunk->begin : LINE_OFFSET_IN_PREV_CHUNK;
+    uint64_t row = 0;
+    size_t counted = chunk->begin;
+    size_t cursor = (size_t)m->prev_match_end;
+    size_t j = 0;
+    while(cursor < chunk->end && !sc->stopped) {
+        size_t match_len;
+        size_t pos = find_pattern(sc, window, cursor, -1, &match_len);
+        if(pos == BTK_SV_NPOS || pos >= chunk->end) break;
+        while(j < chunk->matches.count && chunk->matches.items[j].offset < pos) j += 1;
+        if(j < chunk->matches.count && chunk->matches.items[j].offset == pos && chunk->matches.items[j].len == match_len) return j;
+
+        btk_stringview_t skipped = btk_sv_slice(m->data, counted, pos);
+        size_t newlines = btk_sv_count_byte(skipped, '\n');
+        if(newlines > 0) {
+            row += newlines;
+            line_start = counted + btk_sv_rfind_byte(skipped, '\n') + 1;
+        }
+        counted = pos;
+        chunk_merge_emit(m, (ChunkMatch){ .row = row, .offset = pos, .line_offset = line_start, .len = match_len });
+        cursor = pos + (match_len > 0 ? match_len : 1);
+    }
+    return chunk->matches.count;
+}
+
+// Search in buffer with multiple threads
+// The buffer is split into one chunk per thread with the boundaries moved to the next newline. Each thread
+// reports rows relative to its chunk and how many newlines it has, so the real rows are recovered with the
+// prefix sum of the newline counts while merging the results chunk by chunk. With a single chunk it's just
+// a plain scan of the buffer on the current thread
+void search_in_buffer_chunked(SearchContext *sc, btk_stringview_t data, size_t chunk_count)
+{
+    assert(sc && "Invalid sc pointer");
+    if(chunk_count == 0) chunk_count = 1;
+    ScanChunk *chunks = btk_arena_alloc(&sc->in_file, chunk_count*sizeof(ScanChunk));
+    size_t begin = 0;
+    for(size_t i = 0; i < chunk_count; ++i) {
+        size_t end = i + 1 == chunk_count ? data.count : (size_t)((uint64_t)data.count*(i + 1)/chunk_count);
+        if(end < begin) end = begin;
+        if(i + 1 != chunk_count) {
+            size_t newline = btk_sv_find_byte(btk_sv_slice(data, end, end + CHUNK_SNAP_LIMIT), '\n');
+            if(newline != BTK_SV_NPOS) end += newline + 1;
+        }
+        chunks[i] = (ScanChunk){ .sc = sc, .data = data, .begin = begin, .end = end };
+        begin = end;
+    }
+
+    // The first chunk is scanned by the current thread
+    for(size_t i = 1; i < chunk_count; ++i) {
+        if(btk_thread_create(&chunks[i].thread, scan_chunk, &chunks[i]) != 0) {
+            scan_chunk(&chunks[i]);
+            chunks[i].thread.fn = NULL;
+        }
+    }
+    scan_chunk(&chunks[0]);
+    for(size_t i = 1; i < chunk_count; ++i) {
+        if(chunks[i].thread.fn != NULL) btk_thread_join(&chunks[i].thread);
+    }
+
+    ChunkMerger m = { .sc = sc, .data = data, .line_offset_of_line = UINT64_MAX };
+    for(size_t i = 0; i < chunk_count; ++i) {
+        ScanChunk *chunk = &chunks[i];
+        size_t j = m.prev_match_end > chunk->begin ? chunk_resync(&m, chunk) : 0;
+        for(; j < chunk->matches.count && !sc->stopped; ++j) chunk_merge_emit(&m, chunk->matches.items[j]);
+        m.row_base += chunk->newline_count;
+        if(chunk->last_newline != BTK_SV_NPOS) m.line_start = chunk->last_newline + 1;
+        btk_arena_free(&chunk->arena);
+    }
+}
+
+bool search_in_file_chunked(SearchContext *sc, int fd)
+{
+    assert(sc && "Invalid sc pointer");
+
+    btkfs_mapped_file_t mf;
+    if(btkfs_map_fd(&mf, fd) != 0) {
+        btk_arena_reset(&sc->in_file);
+        return false;
+    }
+    size_t chunk_count = sc->thread_count > 0 ? (size_t)sc->thread_count : 1;
+    search_in_buffer_chunked(sc, btk_sv_from_parts(mf.data, (size_t)mf.size), chunk_count);
+    btkfs_unmap_file(&mf);
+    btk_arena_reset(&sc->in_file);
+    return true;
+}
+
+///////////////////////////////////////////
+///
+/// Context lines
+///
+
+typedef struct LineStart {
+    uint64_t row;
+    size_t offset;
+} LineStart;
+
+// The context lines are delivered straight from the mapped file. The scanning only remembers the starts of the
+// last (before_context + 1) lines in a ring, and only the lines that are delivered are ever looked at
+typedef struct ContextPrinter {
+    SearchContext *sc;
+    btk_stringview_t data;
+    LineStart *ring;
+    size_t ring_capacity;
+    uint64_t ring_count;
+    // Rows before `next_row` are already delivered, `next_offset` is where `next_row` starts
+    uint64_t next_row;
+    size_t next_offset;
+    uint64_t after_until;
+    bool printed_any;
+    // The line of the last match, a long line could have a lot of matches
+    size_t match_line_offset;
+    btk_stringview_t match_line;
+} ContextPrinter;
+
+void context_push_line(ContextPrinter *cp, uint64_t row, size_t offset)
+{
+    cp->ring[cp->ring_count % cp->ring_capacity] = (LineStart){ .row = row, .offset = offset };
+    cp->ring_count += 1;
+}
+
+size_t context_line_offset(const ContextPrinter *cp, uint64_t row)
+{
+    for(size_t i = 0; i < cp->ring_capacity && i < cp->ring_count; ++i) {
+        if(cp->ring[i].row == row) return cp->ring[i].offset;
+    }
+    assert(0 && "The row is not in the ring anymore");
+    return 0;
+}
+
+// `range` starts at `range_offset` and has `newlines` newlines, the last one ends the line before `last_row`.
+// Only the last few of those lines could be printed as the before context, so only they are pushed to the ring
+void context_push_recent_lines(ContextPrinter *cp, btk_stringview_t range, size_t range_offset, uint64_t last_row, size_t newlines)
+{
+    size_t count = newlines < cp->ring_capacity ? newlines : cp->ring_capacity;
+    for(size_t i = 0; i < count; ++i) {
+        size_t newline = btk_sv_rfind_byte(range, '\n');
+        range.count = newline;
+        uint64_t row = last_row - i;
+        cp->ring[(cp->ring_count + count - 1 - i) % cp->ring_capacity] = (LineStart){ .row = row, .offset = range_offset + newline + 1 };
+    }
+    cp->ring_count += count;
+}
+
+btk_stringview_t context_line_at(const ContextPrinter *cp, size_t offset)
+{
+    btk_stringview_t line = btk_sv_slice(cp->data, offset, cp->data.count);
+    size_t newline = btk_sv_find_byte(line, '\n');
+    if(newline != BTK_SV_NPOS) line.count = newline;
+    return line;
+}
+
+SearchResult context_result(ContextPrinter *cp, uint64_t row, size_t line_offset, size_t col, size_t match_len)
+{
+    if(cp->match_line.data == NULL || cp->match_line_offset != line_offset) {
+        cp->match_line = context_line_at(cp, line_offset);
+        cp->match_line_offset = line_offset;
+    }
+    btk_stringview_t preview = line_preview(cp->match_line, col);
+    return (SearchResult){
+        .row = row,
+        .col = col,
+        .offset = line_offset + col,
+        .line_offset = line_offset,
+        .len = match_len,
+        .preview_offset = (uint64_t)(preview.data - cp->data.data),
+        .preview = preview,
+    };
+}
+
+void context_print_line(ContextPrinter *cp, uint64_t row, size_t offset, bool is_match, size_t col, size_t match_len)
+{
+    btk_stringview_t line = context_line_at(cp, offset);
+    if(cp->printed_any && row > cp->next_row) {
+        sc_emit(cp->sc, NG_RECORD_CONTEXT_BREAK, (SearchResult){0});
+    }
+    if(is_match) {
+        sc_emit(cp->sc, NG_RECORD_MATCH, context_result(cp, row, offset, col, match_len));
+    } else {
+        // A long context line is cut like the line of a match at its start
+        btk_stringview_t preview = line_preview(line, 0);
+        sc_emit(cp->sc, NG_RECORD_CONTEXT, (SearchResult){
+            .row = row,
+            .offset = offset,
+            .line_offset = offset,
+            .preview_offset = offset,
+            .preview = preview,
+        });
+    }
+    cp->printed_any = true;
+    cp->next_row = row + 1;
+    cp->next_offset = offset + line.count + 1;
+}
+
+// Print the pending after context lines that come before `upto_row`
+void context_flush_after(ContextPrinter *cp, uint64_t upto_row)
+{
+    uint64_t until = cp->after_until < upto_row ? cp->after_until : upto_row;
+    while(cp->next_row < until && cp->next_offset < cp->data.count && !cp->sc->stopped) {
+        context_print_line(cp, cp->next_row, cp->next_offset, false, 0, 0);
+    }
+}
+
+void context_match(ContextPrinter *cp, uint64_t row, size_t line_offset, size_t col, size_t match_len)
+{
+    // The line is already delivered for an earlier match in the same line, every match still has its record
+    if(row < cp->next_row) {
+        sc_emit(cp->sc, NG_RECORD_MATCH, context_result(cp, row, line_offset, col, match_len));
+        return;
+    }
+    context_flush_after(cp, row);
+    uint64_t first = row > cp->sc->before_context ? row - cp->sc->before_context : 0;
+    if(first < cp->next_row) first = cp->next_row;
+    for(uint64_t r = first; r < row; ++r) {
+        context_print_line(cp, r, context_line_offset(cp, r), false, 0, 0);
+    }
+    context_print_line(cp, row, line_offset, true, col, match_len);
+    cp->after_until = row + 1 + cp->sc->after_context;
+}
+
+// Search in buffer with context lines (-A/-B/-C)
+// Overlapping context windows are merged and separated by a break record otherwise like grep. Each line is
+// delivered once, the other matches of an already delivered line only have their match record
+void search_in_buffer_with_context(SearchContext *sc, btk_stringview_t data)
+{
+    assert(sc && "Invalid sc pointer");
+
+    ContextPrinter cp = {
+        .sc = sc,
+        .data = data,
+        .ring_capacity = sc->before_context + 1,
+    };
+    cp.ring = btk_arena_alloc(&sc->in_file, cp.ring_capacity*sizeof(LineStart));
+    context_push_line(&cp, 0, 0);
+
+    uint64_t row = 0;
+    size_t line_start = 0;
+    size_t counted = 0;
+    size_t cursor = 0;
+    while(cursor < data.count && !sc->stopped) {
+        size_t match_len;
+        size_t pos = find_pattern(sc, data, cursor, -1, &match_len);
+        if(pos == BTK_SV_NPOS) break;
+
+        btk_stringview_t skipped = btk_sv_slice(data, counted, pos);
+        size_t newlines = btk_sv_count_byte(skipped, '\n');
+        if(newlines > 0) {
+            row += newlines;
+            context_push_recent_lines(&cp, skipped, counted, row, newlines);
+            line_start = context_line_offset(&cp, row);
+        }
+        counted = pos;
+
+        sc->find_count += 1;
+        context_match(&cp, row, line_start, pos - line_start, match_len);
+        cursor = pos + (match_len > 0 ? match_len : 1);
+    }
+    context_flush_after(&cp, UINT64_MAX);
+}
+
+bool search_in_file_with_context(SearchContext *sc, int fd)
+{
+    assert(sc && "Invalid sc pointer");
+
+    btkfs_mapped_file_t mf;
+    if(btkfs_map_fd(&mf, fd) != 0) {
+        btk_arena_reset(&sc->in_file);
+        return false;
+    }
+    btk_stringview_t data = btk_sv_from_parts(mf.data, (size_t)mf.size);
+    search_in_buffer_with_context(sc, data);
+    btkfs_unmap_file(&mf);
+    btk_arena_reset(&sc->in_file);
+    return true;
+}
+
+///////////////////////////////////////////
+///
+/// Byte pattern searching
+///
+
+int hex_digit_value(char ch)
+{
+    if(ch >= '0' && ch <= '9') return ch - '0';
+    if(ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if(ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Parse "0xDEADBEEF", "DE AD BE EF" or "DE ?? B? EF". Spaces are ignored and every 2 digits is a byte
+bool parse_byte_pattern(btk_arena_t *a, btk_stringview_t text, BytePattern *bp)
+{
+    if(text.count >= 2 && text.data[0] == '0' && (text.data[1] == 'x' || text.data[1] == 'X')) {
+        text = btk_sv_slice(text, 2, text.count);
+    }
+    *bp = (BytePattern){0};
+    bp->bytes = btk_arena_alloc(a, text.count/2 + 1);
+    bp->masks = btk_arena_alloc(a, text.count/2 + 1);
+    size_t nibble_count = 0;
+    for(size_t i = 0; i < text.count; ++i) {
+        char ch = text.data[i];
+        if(ch == ' ') continue;
+        unsigned char value = 0;
+        unsigned char mask = 0;
+        if(ch != '?') {
+            int digit = hex_digit_value(ch);
+            if(digit < 0) return false;
+            value = (unsigned char)digit;
+            mask = 0xF;
+        }
+        size_t index = nibble_count/2;
+        if(nibble_count%2 == 0) {
+            bp->bytes[index] = value << 4;
+            bp->masks[index] = mask << 4;
+        } else {
+            bp->bytes[index] |= value;
+            bp->masks[index] |= mask;
+        }
+        nibble_count += 1;
+    }
+    if(nibble_count == 0 || nibble_count%2 != 0) return false;
+    bp->count = nibble_count/2;
+
+    for(size_t i = 0; i < bp->count;) {
+        if(bp->masks[i] != 0xFF) {
+            i += 1;
+            continue;
+        }
+        size_t run = 0;
+        while(i + run < bp->count && bp->masks[i + run] == 0xFF) run += 1;
+        if(run > bp->anchor_count) {
+            bp->anchor_offset = i;
+            bp->anchor_count = run;
+        }
+        i += run;
+    }
+    return true;
+}
+
+bool byte_pattern_matches_at(const BytePattern *bp, btk_stringview_t data, size_t start)
+{
+    if(start + bp->count > data.count) return false;
+    const unsigned char *bytes = (const unsigned char *)data.data + start;
+    for(size_t i = 0; i < bp->count; ++i) {
+        if((bytes[i] & bp->masks[i]) != bp->bytes[i]) return false;
+    }
+    return true;
+}
+
+// Search for a pattern of bytes i.e. `--hex DEADBEEF` for core dumps and firmware blobs. The fully known bytes
+// are searched with btk_sv_find and the wildcard ones are checked around each candidate. There're no lines in
+// a byte file, so the results only have the byte offset
+void search_in_buffer2(SearchContext *sc, btk_stringview_t data)
+{
+    assert(sc && "Invalid sc pointer");
+    const BytePattern *bp = &sc->pattern->byte_pattern;
+    btk_stringview_t anchor = btk_sv_from_parts((const char *)bp->bytes + bp->anchor_offset, bp->anchor_count);
+
+    size_t cursor = bp->anchor_offset;
+    while(cursor < data.count && !sc->stopped) {
+        size_t found = btk_sv_find(btk_sv_slice(data, cursor, data.count), anchor);
+        if(found == BTK_SV_NPOS) break;
+        size_t start = cursor + found - bp->anchor_offset;
+        if(byte_pattern_matches_at(bp, data, start)) {
+            sc->find_count += 1;
+            sc_emit(sc, NG_RECORD_MATCH, (SearchResult){
+                .offset = start,
+                .len = bp->count,
+                .preview_offset = start,
+                .preview = btk_sv_from_parts(data.data + start, bp->count),
+            });
+            cursor = start + bp->count + bp->anchor_offset;
+        } else {
+            cursor += found + 1;
+        }
+    }
+}
+
+// Search in file 2nd version
+// Map the whole file and search it for the byte pattern
+bool search_in_file2(SearchContext *sc, int fd)
+{
+    assert(sc && "Invalid sc pointer");
+
+    btkfs_mapped_file_t mf;
+    if(btkfs_map_fd(&mf, fd) != 0) {
+        btk_arena_reset(&sc->in_file);
+        return false;
+    }
+    search_in_buffer2(sc, btk_sv_from_parts(mf.data, (size_t)mf.size));
+    btkfs_unmap_file(&mf);
+    btk_arena_reset(&sc->in_file);
+    return true;
+}
+
+///////////////////////////////////////////
+///
+/// Text encodings
+///
+
+typedef enum TextEncoding {
+    ENCODING_UTF8 = 0,
+    ENCODING_UTF16LE,
+    ENCODING_UTF16BE,
+} TextEncoding;
+
+// Only UTF-16 is told by its byte order mark, everything else is searched as UTF-8 bytes
+TextEncoding detect_encoding(const unsigned char *bom, size_t count)
+{
+    if(count >= 2 && bom[0] == 0xFF && bom[1] == 0xFE) return ENCODING_UTF16LE;
+    if(count >= 2 && bom[0] == 0xFE && bom[1] == 0xFF) return ENCODING_UTF16BE;
+    return ENCODING_UTF8;
+}
+
+// UTF-16 is transcoded into UTF-8 as it's read, so the pattern and the output stay UTF-8. The offsets and rows
+// are of the transcoded data just like the decompressed files
+typedef struct Utf16Reader {
+    FileReader *fr;
+    bool big_endian;
+    unsigned char *in;
+    size_t in_capacity;
+    size_t in_begin;
+    size_t in_end;
+    bool eof;
+    // The rest of a character that didn't fit in the last read
+    char pending[4];
+    size_t pending_begin;
+    size_t pending_end;
+} Utf16Reader;
+
+// Narrow the UTF-16LE units below 0x80 straight into bytes, 8 units at a time with SSE2
+// This function returns size_t which is the number of units narrowed, it stops at the first non ASCII one
+size_t utf16le_narrow_ascii(const unsigned char *in, size_t units, char *out)
+{
+    size_t i = 0;
+#ifdef NOTGREP_SSE2
+    const __m128i high = _mm_set1_epi16((short)0xFF80);
+    for(; i + 8 <= units; i += 8) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(in + 2*i));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(block, high), _mm_setzero_si128())) != 0xFFFF) break;
+        _mm_storel_epi64((__m128i *)(out + i), _mm_packus_epi16(block, block));
+    }
+#endif
+    for(; i < units && in[2*i + 1] == 0 && in[2*i] < 0x80; ++i) out[i] = (char)in[2*i];
+    return i;
+}
+
+size_t utf8_encode(uint32_t cp, char *out)
+{
+    if(cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    } else if(cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    } else if(cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+uint32_t utf16_unit(const Utf16Reader *ur, size_t at)
+{
+    const unsigned char *unit = ur->in + at;
+    return ur->big_endian ? ((uint32_t)unit[0] << 8) | unit[1] : ((uint32_t)unit[1] << 8) | unit[0];
+}
+
+size_t utf16_read(void *user, char *buf, size_t bufsz)
+{
+    Utf16Reader *ur = user;
+    size_t out = 0;
+    while(out < bufsz) {
+        if(ur->pending_begin < ur->pending_end) {
+            buf[out++] = ur->pending[ur->pending_begin++];
+            continue;
+        }
+        // A surrogate pair needs 4 bytes in the input
+        if(ur->in_end - ur->in_begin < 4 && !ur->eof) {
+            memmove(ur->in, ur->in + ur->in_begin, ur->in_end - ur->in_begin);
+            ur->in_end -= ur->in_begin;
+            ur->in_begin = 0;
+            size_t n = read_from_fd(ur->fr, (char *)ur->in + ur->in_end, ur->in_capacity - ur->in_end);
+            if(n == 0) ur->eof = true;
+            ur->in_end += n;
+            continue;
+        }
+        size_t available = ur->in_end - ur->in_begin;
+        if(available < 2) break; // A trailing odd byte is dropped
+        if(!ur->big_endian) {
+            size_t units = available/2 < bufsz - out ? available/2 : bufsz - out;
+            size_t narrowed = utf16le_narrow_ascii(ur->in + ur->in_begin, units, buf + out);
+            ur->in_begin += 2*narrowed;
+            out += narrowed;
+            if(narrowed > 0) continue;
+        }
+
+        uint32_t cp = utf16_unit(ur, ur->in_begin);
+        size_t used = 2;
+        if(cp >= 0xD800 && cp <= 0xDBFF && available >= 4) {
+            uint32_t low = utf16_unit(ur, ur->in_begin + 2);
+            if(low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                used = 4;
+            }
+        }
+        // An unpaired surrogate is replaced
+        if(cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+        ur->in_begin += used;
+        if(bufsz - out >= 4) {
+            out += utf8_encode(cp, buf + out);
+        } else {
+            ur->pending_begin = 0;
+            ur->pending_end = utf8_encode(cp, ur->pending);
+        }
+    }
+    return out;
+}
+
+// The first `filled` bytes of the file are in the window already, they're moved to the input of the transcoder
+// so the window could take the transcoded data
+bool search_in_utf16_file(SearchContext *sc, FileReader *fr, size_t filled, bool big_endian, uint64_t *size)
+{
+    Utf16Reader ur = {
+        .fr = fr,
+        .big_endian = big_endian,
+        .in = btk_arena_alloc(&sc->in_file, sc->readbufsz),
+        .in_capacity = sc->readbufsz,
+        .in_begin = 2, // The byte order mark
+        .in_end = filled,
+    };
+    memcpy(ur.in, sc->readbuf, filled);
+    if(sc->before_context > 0 || sc->after_context > 0) {
+        size_t count;
+        char *data = read_all(utf16_read, &ur, sc->readbufsz, &count);
+        if(data != NULL) {
+            search_in_buffer_with_context(sc, btk_sv_from_parts(data, count));
+            free(data);
+        }
+    } else {
+        search_in_stream(sc, 0, utf16_read, &ur);
+    }
+    btk_arena_reset(&sc->in_file);
+    *size = fr->total;
+    return true;
+}
+
+///////////////////////////////////////////
+///
+/// Bloom filters
+///
+
+// A sidecar file has a Bloom filter of the 3 byte grams of every indexed file. A pattern's grams are tested against
+// the filter of a file before it's opened, and the file is skipped if one of them is surely not in it. A file is
+// known by its device and inode like in the result cache, and the filter is only used while its size and
+// modification time are the same, so an appended file is searched until it's indexed again.
+// Layout: BloomHeader, BloomEntry[entry_count] sorted by device and inode, the bits of the filters as uint64_t words
+#define BLOOM_MAGIC 0x4642474eu // "NGBF"
+#define BLOOM_GRAM_SIZE 3
+#define BLOOM_MAX_HASHES 16
+#define BLOOM_READ_SIZE (256*1024)
+
+typedef struct BloomHeader {
+    uint32_t magic;
+    uint32_t hash_count;
+    uint64_t entry_count;
+    uint64_t word_count;
+    uint64_t reserved;
+} BloomHeader;
+
+typedef struct BloomEntry {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime_ns;
+    uint64_t words; // The first word of the filter
+    uint64_t bit_count; // 0 if there's no filter, i.e. the file is compressed, so it's always searched
+} BloomEntry;
+
+struct ng_bloom_builder {
+    uint32_t hash_count;
+    double bits_per_gram;
+    uint64_t *seen; // A bit for every possible gram, only the bits of `grams` are set between two files
+    struct {
+        uint32_t *items;
+        size_t count;
+        size_t capacity;
+    } grams;
+    struct {
+        BloomEntry *items;
+        size_t count;
+        size_t capacity;
+    } entries;
+    struct {
+        uint64_t *items;
+        size_t count;
+        size_t capacity;
+    } words;
+    char *readbuf;
+    char *pathbuf;
+    size_t pathbufsz;
+};
+
+struct ng_bloom {
+    btkfs_mapped_file_t file;
+    uint32_t hash_count;
+    const BloomEntry *entries;
+    size_t entry_count;
+    const uint64_t *words;
+    uint64_t word_count;
+};
+
+// The positions of a gram in a filter are h1 + i*h2, two halves of a single hash
+uint64_t bloom_gram_hash(uint32_t gram)
+{
+    return cache_mix(cache_mix(0x9e3779b97f4a7c15ull, gram), gram);
+}
+
+static inline uint64_t bloom_bit(uint64_t hash, uint32_t i, uint64_t bit_count)
+{
+    uint64_t h1 = hash & 0xFFFFFFFFu;
+    uint64_t h2 = (hash >> 32) | 1;
+    return (h1 + i*h2) % bit_count;
+}
+
+bool bloom_collect_grams(ng_bloom_builder_t *b, const unsigned char *data, size_t count, uint32_t *gram, uint64_t offset)
+{
+    for(size_t i = 0; i < count; ++i) {
+        *gram = ((*gram << 8) | data[i]) & 0xFFFFFF;
+        if(offset + i + 1 < BLOOM_GRAM_SIZE) continue;
+        uint64_t bit = 1ull << (*gram & 63);
+        if(b->seen[*gram >> 6] & bit) continue;
+        if(!grow_array((void **)&b->grams.items, &b->grams.capacity, b->grams.count + 1, sizeof(uint32_t))) return false;
+        b->seen[*gram >> 6] |= bit;
+        b->grams.items[b->grams.count++] = *gram;
+    }
+    return true;
+}
+
+int bloom_entry_compare(const void *a, const void *b)
+{
+    const BloomEntry *x = a;
+    const BloomEntry *y = b;
+    if(x->device != y->device) return x->device < y->device ? -1 : 1;
+    return x->inode < y->inode ? -1 : x->inode > y->inode ? 1 : 0;
+}
+
+// This function returns const BloomEntry * which is NULL if the file isn't indexed or it's changed since then
+const BloomEntry *bloom_lookup(const ng_bloom_t *bloom, const btkfs_file_id_t *id)
+{
+    BloomEntry key = { .device = id->device, .inode = id->inode };
+    const BloomEntry *entry = bsearch(&key, bloom->entries, bloom->entry_count, sizeof(BloomEntry), bloom_entry_compare);
+    if(entry == NULL || entry->size != id->size || entry->mtime_ns != id->mtime_ns) return NULL;
+    if(entry->bit_count == 0 || entry->words > bloom->word_count || entry->bit_count/64 > bloom->word_count - entry->words) return NULL;
+    return entry;
+}
+
+// This function returns bool which is false if one of the grams is surely not in the file
+bool bloom_may_contain(const ng_bloom_t *bloom, const BloomEntry *entry, const uint64_t *hashes, size_t count)
+{
+    const uint64_t *words = bloom->words + entry->words;
+    for(size_t i = 0; i < count; ++i) {
+        for(uint32_t j = 0; j < bloom->hash_count; ++j) {
+            uint64_t bit = bloom_bit(hashes[i], j, entry->bit_count);
+            if((words[bit >> 6] & (1ull << (bit & 63))) == 0) return false;
+        }
+    }
+    return true;
+}
+
+///////////////////////////////////////////
+///
+/// Suffix array index
+///
+
+// The files of a frozen corpus are concatenated into a single text and every suffix of it is sorted, so every
+// occurrence of a pattern is a range of the suffix array that's found with two binary searches, without reading
+// the files. The offsets of the newlines are kept too, so a match is put back on its file and row from the index alone.
+// Layout: SuffixArrayHeader, SuffixArrayDoc[doc_count], the paths, the text, int64_t[text_size + 1] suffix array
+// and uint64_t[line_count] offsets of the newlines. The sections are at multiples of 8
+#define SUFFIX_ARRAY_MAGIC 0x4153474eu // "NGSA"
+
+typedef struct SuffixArrayHeader {
+    uint32_t magic; // Written last, so an index that's not built completely isn't opened
+    uint32_t reserved;
+    uint64_t doc_count;
+    uint64_t text_size;
+    uint64_t line_count;
+    uint64_t paths_offset;
+    uint64_t text_offset;
+    uint64_t sa_offset;
+    uint64_t lines_offset;
+} SuffixArrayHeader;
+
+typedef struct SuffixArrayDoc {
+    uint64_t start; // Offset of the file in the text
+    uint64_t size;
+    uint64_t path; // Offset of the path in the paths, it's NUL terminated
+    uint64_t first_line; // The first newline at or after `start`
+} SuffixArrayDoc;
+
+struct ng_suffix_array_builder {
+    struct {
+        SuffixArrayDoc *items;
+        size_t count;
+        size_t capacity;
+    } docs;
+    struct {
+        char *items;
+        size_t count;
+        size_t capacity;
+    } paths;
+    char *pathbuf;
+    size_t pathbufsz;
+};
+
+struct ng_suffix_array {
+    btkfs_mapped_file_t file;
+    const SuffixArrayHeader *header;
+    const SuffixArrayDoc *docs;
+    const char *paths;
+    const unsigned char *text;
+    const int64_t *sa;
+    const uint64_t *lines;
+};
+
+// SA-IS by Nong, Zhang and Chan. The text is either the bytes of the corpus followed by a virtual sentinel that's
+// smaller than every byte (the bytes are 1..256 then), or the names of the LMS substrings of the level above
+// that already end with the smallest one. L and S types are a bit per position
+typedef struct SaisText {
+    const unsigned char *bytes; // NULL if it's the names
+    const int64_t *names;
+    int64_t count;
+    unsigned char *types; // Bit set if it's S type
+} SaisText;
+
+static inline int64_t sais_char(const SaisText *st, int64_t i)
+{
+    if(st->bytes == NULL) return st->names[i];
+    return i == st->count - 1 ? 0 : (int64_t)st->bytes[i] + 1;
+}
+
+static inline bool sais_is_s(const SaisText *st, int64_t i) { return (st->types[i >> 3] >> (i & 7)) & 1; }
+static inline bool sais_is_lms(const SaisText *st, int64_t i) { return i > 0 && sais_is_s(st, i) && !sais_is_s(st, i - 1); }
+
+void sais_buckets(const SaisText *st, int64_t *buckets, int64_t alphabet, bool ends)
+{
+    memset(buckets, 0, (size_t)alphabet*sizeof(int64_t));
+    for(int64_t i = 0; i < st->count; ++i) buckets[sais_char(st, i)] += 1;
+    int64_t sum = 0;
+    for(int64_t c = 0; c < alphabet; ++c) {
+        sum += buckets[c];
+        buckets[c] = ends ? sum : sum - buckets[c];
+    }
+}
+
+// The L type suffixes are put after the sorted ones from the front of their buckets, then the S type ones
+// from the back
+void sais_induce(const SaisText *st, int64_t *sa, int64_t *buckets, int64_t alphabet)
+{
+    sais_buckets(st, buckets, alphabet, false);
+    for(int64_t i = 0; i < st->count; ++i) {
+        int64_t j = sa[i] - 1;
+        if(sa[i] > 0 && !sais_is_s(st, j)) sa[buckets[sais_char(st, j)]++] = j;
+    }
+    sais_buckets(st, buckets, alphabet, true);
+    for(int64_t i = st->count - 1; i >= 0; --i) {
+        int64_t j = sa[i] - 1;
+        if(sa[i] > 0 && sais_is_s(st, j)) sa[--buckets[sais_char(st, j)]] = j;
+    }
+}
+
+// This function returns bool which is false if there's no memory
+bool sais(const unsigned char *bytes, const int64_t *names, int64_t *sa, int64_t n, int64_t alphabet)
+{
+    SaisText st = { .bytes = bytes, .names = names, .count = n, .types = calloc((size_t)(n/8 + 1), 1) };
+    int64_t *buckets = malloc((size_t)alphabet*sizeof(int64_t));
+    if(st.types == NULL || buckets == NULL) {
+        free(st.types);
+        free(buckets);
+        return false;
+    }
+    // The sentinel is S type and the one before it is L type
+    st.types[(n - 1) >> 3] |= 1 << ((n - 1) & 7);
+    for(int64_t i = n - 3; i >= 0; --i) {
+        int64_t c = sais_char(&st, i), next = sais_char(&st, i + 1);
+        if(c < next || (c == next && sais_is_s(&st, i + 1))) st.types[i >> 3] |= 1 << (i & 7);
+    }
+
+    // 1. Sort the LMS substrings by inducing from them in any order
+    sais_buckets(&st, buckets, alphabet, true);
+    for(int64_t i = 0; i < n; ++i) sa[i] = -1;
+    for(int64_t i = 1; i < n; ++i) {
+        if(sais_is_lms(&st, i)) sa[--buckets[sais_char(&st, i)]] = i;
+    }
+    sais_induce(&st, sa, buckets, alphabet);
+
+    // 2. Name them, equal substrings get the same name. The names are put in the order of the positions at the end
+    // of `sa`, two LMS positions are never next to each other so position/2 is unique
+    int64_t lms_count = 0;
+    for(int64_t i = 0; i < n; ++i) {
+        if(sais_is_lms(&st, sa[i])) sa[lms_count++] = sa[i];
+    }
+    for(int64_t i = lms_count; i < n; ++i) sa[i] = -1;
+    int64_t name_count = 0, prev = -1;
+    for(int64_t i = 0; i < lms_count; ++i) {
+        int64_t pos = sa[i];
+        bool differ = prev < 0;
+        for(int64_t d = 0; !differ; ++d) {
+            if(sais_char(&st, pos + d) != sais_char(&st, prev + d) || sais_is_s(&st, pos + d) != sais_is_s(&st, prev + d)) differ = true;
+            else if(d > 0 && (sais_is_lms(&st, pos + d) || sais_is_lms(&st, prev + d))) break;
+        }
+        if(differ) {
+            name_count += 1;
+            prev = pos;
+        }
+        sa[lms_count + pos/2] = name_count - 1;
+    }
+    for(int64_t i = n - 1, j = n - 1; i >= lms_count; --i) {
+        if(sa[i] >= 0) sa[j--] = sa[i];
+    }
+
+    // 3. Sort the LMS suffixes by the suffixes of their names, that's the same problem at most half as big
+    int64_t *reduced = sa + n - lms_count;
+    bool ok = true;
+    if(name_count < lms_count) ok = sais(NULL, reduced, sa, lms_count, name_count);
+    else for(int64_t i = 0; i < lms_count; ++i) sa[reduced[i]] = i;
+
+    // 4. Induce the whole suffix array from the sorted LMS suffixes
+    if(ok) {
+        sais_buckets(&st, buckets, alphabet, true);
+        for(int64_t i = 1, j = 0; i < n; ++i) {
+            if(sais_is_lms(&st, i)) reduced[j++] = i;
+        }
+        for(int64_t i = 0; i < lms_count; ++i) sa[i] = reduced[sa[i]];
+        for(int64_t i = lms_count; i < n; ++i) sa[i] = -1;
+        for(int64_t i = lms_count - 1; i >= 0; --i) {
+            int64_t j = sa[i];
+            sa[i] = -1;
+            sa[--buckets[sais_char(&st, j)]] = j;
+        }
+        sais_induce(&st, sa, buckets, alphabet);
+    }
+    free(buckets);
+    free(st.types);
+    return ok;
+}
+
+// The suffix array of `count` bytes has `count + 1` items, the first one is the sentinel
+// This function returns bool which is false if there's no memory
+bool build_suffix_array(const unsigned char *text, uint64_t count, int64_t *sa)
+{
+    if(count == 0) {
+        sa[0] = 0;
+        return true;
+    }
+    return sais(text, NULL, sa, (int64_t)count + 1, 257);
+}
+
+// Compare the pattern with the start of the suffix, a suffix shorter than the pattern is smaller if it's equal
+int suffix_compare(const ng_suffix_array_t *index, int64_t suffix, btk_stringview_t pattern)
+{
+    uint64_t left = index->header->text_size - (uint64_t)suffix;
+    size_t count = left < pattern.count ? (size_t)left : pattern.count;
+    int res = memcmp(index->text + suffix, pattern.data, count);
+    if(res != 0) return res;
+    return count < pattern.count ? -1 : 0;
+}
+
+// This function returns uint64_t which is the first item of the suffix array that's not less than the pattern, or
+// that's greater than it if `after` is true
+uint64_t suffix_array_bound(const ng_suffix_array_t *index, btk_stringview_t pattern, bool after)
+{
+    uint64_t lo = 0, hi = index->header->text_size + 1;
+    while(lo < hi) {
+        uint64_t mid = lo + (hi - lo)/2;
+        int res = suffix_compare(index, index->sa[mid], pattern);
+        if(res < 0 || (after && res == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// This function returns uint64_t which is the index of the first newline at or after `offset`
+uint64_t suffix_array_line(const ng_suffix_array_t *index, uint64_t offset)
+{
+    uint64_t lo = 0, hi = index->header->line_count;
+    while(lo < hi) {
+        uint64_t mid = lo + (hi - lo)/2;
+        if(index->lines[mid] < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// The occurrences are delivered in the order of the files like a search does, so the overlapping ones and the ones
+// without the -w/-x boundaries are dropped the same way
+void search_in_suffix_array(SearchContext *sc, const ng_suffix_array_t *index)
+{
+    btk_stringview_t pattern = sc->pattern->text;
+    uint64_t first = suffix_array_bound(index, pattern, false);
+    uint64_t last = suffix_array_bound(index, pattern, true);
+    if(first >= last) return;
+    uint64_t *hits = malloc((size_t)(last - first)*sizeof(uint64_t));
+    if(hits == NULL) return;
+    for(uint64_t i = first; i < last; ++i) hits[i - first] = (uint64_t)index->sa[i];
+    qsort(hits, (size_t)(last - first), sizeof(uint64_t), compare_u64);
+
+    const SuffixArrayHeader *h = index->header;
+    uint64_t doc = 0;
+    uint64_t cursor = 0;
+    for(uint64_t i = 0; i < last - first && !sc->stopped; ++i) {
+        uint64_t pos = hits[i];
+        if(pos < cursor) continue;
+        while(doc + 1 < h->doc_count && index->docs[doc].start + index->docs[doc].size <= pos) doc += 1;
+        const SuffixArrayDoc *d = &index->docs[doc];
+        uint64_t doc_end = d->start + d->size;
+        // The files are next to each other in the text, a match can't go on to the next one
+        if(pos + pattern.count > doc_end) continue;
+        if(sc->pattern->boundary != BOUNDARY_NONE) {
+            int before = pos > d->start ? index->text[pos - 1] : -1;
+            int after = pos + pattern.count < doc_end ? index->text[pos + pattern.count] : -1;
+            if(!pattern_has_boundaries(sc->pattern, before, after)) continue;
+        }
+        uint64_t line = suffix_array_line(index, pos);
+        uint64_t line_start = line > d->first_line ? index->lines[line - 1] + 1 : d->start;
+        uint64_t line_end = line < h->line_count && index->lines[line] < doc_end ? index->lines[line] : doc_end;
+        btk_stringview_t text = btk_sv_from_parts((const char *)index->text + line_start, (size_t)(line_end - line_start));
+        btk_stringview_t preview = line_preview(text, (size_t)(pos - line_start));
+        if(sc->file.path.data != index->paths + d->path) sc_set_file_path(sc, index->paths + d->path);
+        sc->find_count += 1;
+        sc_emit(sc, NG_RECORD_MATCH, (SearchResult){
+            .row = line - d->first_line,
+            .col = pos - line_start,
+            .offset = pos - d->start,
+            .line_offset = line_start - d->start,
+            .len = pattern.count,
+            .preview_offset = (uint64_t)(preview.data - (const char *)index->text) - d->start,
+            .preview = preview,
+        });
+        cursor = pos + pattern.count;
+    }
+    free(hits);
+}
+
+///////////////////////////////////////////
+///
+/// Line index
+///
+
+// A `.nglines` sidecar of a file has the offsets where every `interval`-th row starts, so a row is found by counting
+// the newlines from the checkpoint before it instead of from the start of the file. The checkpoints are the deltas
+// from the one before as LEB128, and a block of them starts with its whole offset so any of them is decoded from at
+// most LINE_INDEX_BLOCK - 1 deltas. It's for append-only logs: it's used as long as the file is the same inode and
+// at least as big as what's indexed, and writing it again only reads what's appended since.
+// Layout: LineIndexHeader, LineIndexBlock[block_count], the deltas
+#define LINE_INDEX_MAGIC 0x314c474eu // "NGL1"
+#define LINE_INDEX_BLOCK 64
+#define LINE_INDEX_EXTENSION ".nglines"
+#define LINE_INDEX_TAIL_SIZE 64
+
+typedef struct LineIndexHeader {
+    uint32_t magic;
+    uint32_t interval;
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size; // Bytes of the file that are indexed
+    uint64_t line_count; // Newlines in them
+    uint64_t checkpoint_count; // The first one is always row 0 at offset 0
+    uint64_t deltas_size;
+    uint64_t tail_hash; // Hash of the last LINE_INDEX_TAIL_SIZE bytes that are indexed
+} LineIndexHeader;
+
+typedef struct LineIndexBlock {
+    uint64_t offset; // Offset of the first checkpoint of the block
+    uint64_t deltas; // Where the deltas of the next checkpoints of the block start
+} LineIndexBlock;
+
+typedef struct LineIndex {
+    btkfs_mapped_file_t file;
+    const LineIndexHeader *header;
+    const LineIndexBlock *blocks;
+    const unsigned char *deltas;
+} LineIndex;
+
+// This function returns size_t which is the number of bytes of the value, 0 if it's cut
+size_t varint_decode(const unsigned char *data, size_t count, uint64_t *value)
+{
+    *value = 0;
+    for(size_t i = 0; i < count && i < 10; ++i) {
+        *value |= (uint64_t)(data[i] & 0x7F) << (7*i);
+        if((data[i] & 0x80) == 0) return i + 1;
+    }
+    return 0;
+}
+
+size_t varint_encode(uint64_t value, unsigned char *out)
+{
+    size_t count = 0;
+    do {
+        out[count] = (unsigned char)(value & 0x7F);
+        value >>= 7;
+        if(value != 0) out[count] |= 0x80;
+        count += 1;
+    } while(value != 0);
+    return count;
+}
+
+// A sidecar of another file (or of what's not the start of this one anymore) is not used
+// This function returns bool which is false if there's no usable sidecar at `indexpath`
+bool line_index_open(LineIndex *li, const char *indexpath, const btkfs_file_id_t *id)
+{
+    if(btkfs_map_file(&li->file, indexpath) != 0) return false;
+    const LineIndexHeader *h = (const LineIndexHeader *)li->file.data;
+    uint64_t size = li->file.size;
+    uint64_t block_count = 0;
+    bool valid = size >= sizeof(LineIndexHeader) && h->magic == LINE_INDEX_MAGIC && h->interval > 0
+        && h->device == id->device && h->inode == id->inode && h->size <= id->size
+        && h->checkpoint_count > 0 && h->checkpoint_count - 1 == h->line_count/h->interval;
+    if(valid) {
+        block_count = (h->checkpoint_count + LINE_INDEX_BLOCK - 1)/LINE_INDEX_BLOCK;
+        valid = block_count <= (size - sizeof(LineIndexHeader))/sizeof(LineIndexBlock)
+            && h->deltas_size == size - sizeof(LineIndexHeader) - block_count*sizeof(LineIndexBlock);
+    }
+    if(!valid) {
+        btkfs_unmap_file(&li->file);
+        return false;
+    }
+    li->header = h;
+    li->blocks = (const LineIndexBlock *)(h + 1);
+    li->deltas = (const unsigned char *)(li->blocks + block_count);
+    return true;
+}
+
+void line_index_close(LineIndex *li)
+{
+    btkfs_unmap_file(&li->file);
+}
+
+// This function returns uint64_t which is the offset where row `checkpoint*interval` starts
+uint64_t line_index_checkpoint(const LineIndex *li, uint64_t checkpoint)
+{
+    const LineIndexBlock *block = &li->blocks[checkpoint/LINE_INDEX_BLOCK];
+    uint64_t offset = block->offset;
+    uint64_t at = block->deltas;
+    for(uint64_t i = 0; i < checkpoint % LINE_INDEX_BLOCK && at < li->header->deltas_size; ++i) {
+        uint64_t delta;
+        size_t count = varint_decode(li->deltas + at, (size_t)(li->header->deltas_size - at), &delta);
+        if(count == 0) break;
+        offset += delta;
+        at += count;
+    }
+    return offset;
+}
+
+// This function returns bool which is false if the bytes up to `size` can't be read
+bool line_index_tail_hash(int fd, uint64_t size, uint64_t *hash)
+{
+    char tail[LINE_INDEX_TAIL_SIZE];
+    size_t count = size < LINE_INDEX_TAIL_SIZE ? (size_t)size : LINE_INDEX_TAIL_SIZE;
+    if(btkfs_read_file_at(fd, tail, count, size - count) != (long long)count) return false;
+    *hash = hash_path_bytes(HASH_SEED, tail, count);
+    return true;
+}
+
+// The same inode could be truncated and written again instead of appended to, then the bytes at the end of what's
+// indexed are most likely different
+// This function returns bool which is false if the sidecar isn't of what's in the file now
+bool line_index_matches(const LineIndex *li, int fd)
+{
+    uint64_t hash;
+    return line_index_tail_hash(fd, li->header->size, &hash) && hash == li->header->tail_hash;
+}
+
+// Move `*offset` and `*from_row` to the last checkpoint at or before `row`, unless they're already past it
+void line_index_nearest(const LineIndex *li, uint64_t row, uint64_t *offset, uint64_t *from_row)
+{
+    uint64_t checkpoint = row/li->header->interval;
+    if(checkpoint >= li->header->checkpoint_count) checkpoint = li->header->checkpoint_count - 1;
+    if(checkpoint*li->header->interval <= *from_row) return;
+    *offset = line_index_checkpoint(li, checkpoint);
+    *from_row = checkpoint*li->header->interval;
+}
+
+// Count the newlines from `*offset`, the start of `from_row`, until it's the start of `row`
+// This function returns bool which is false if the file ends before that row
+bool seek_row(SearchContext *sc, int fd, uint64_t *offset, uint64_t from_row, uint64_t row)
+{
+    while(from_row < row) {
+        long long n = btkfs_read_file_at(fd, sc->readbuf, sc->readbufsz, *offset);
+        if(n <= 0) return false;
+        const char *at = sc->readbuf, *end = sc->readbuf + n;
+        while(from_row < row && (at = memchr(at, '\n', (size_t)(end - at))) != NULL) {
+            at += 1;
+            from_row += 1;
+        }
+        *offset += from_row == row ? (uint64_t)(at - sc->readbuf) : (uint64_t)n;
+    }
+    return true;
+}
+
+// Search only the rows from `sc->first_row` to `sc->last_row` of a plain file. Their offsets are found from the
+// `.nglines` sidecar of the file if it has one, or by counting the newlines from the start of the file otherwise
+void search_in_file_rows(SearchContext *sc, int fd, uint64_t *size)
+{
+    btk_stringview_t path = sc_file_path(sc);
+    char *indexpath = btk_arena_alloc(&sc->in_file, path.count + sizeof(LINE_INDEX_EXTENSION));
+    memcpy(indexpath, path.data, path.count);
+    memcpy(indexpath + path.count, LINE_INDEX_EXTENSION, sizeof(LINE_INDEX_EXTENSION));
+    btkfs_file_id_t id;
+    LineIndex li;
+    bool indexed = sc_get_file_id(sc, &id) && line_index_open(&li, indexpath, &id);
+    if(indexed && !line_index_matches(&li, fd)) {
+        line_index_close(&li);
+        indexed = false;
+    }
+
+    uint64_t begin = 0, begin_row = 0;
+    if(indexed) line_index_nearest(&li, sc->first_row, &begin, &begin_row);
+    bool found = seek_row(sc, fd, &begin, begin_row, sc->first_row);
+    uint64_t end = UINT64_MAX, end_row = sc->first_row;
+    if(found && sc->last_row != UINT64_MAX) {
+        end = begin;
+        if(indexed) line_index_nearest(&li, sc->last_row + 1, &end, &end_row);
+        if(!seek_row(sc, fd, &end, end_row, sc->last_row + 1)) end = UINT64_MAX;
+    }
+    if(indexed) line_index_close(&li);
+
+    RangeReader rr = { .fd = fd, .offset = begin, .end = end };
+    if(found) search_in_stream_from(sc, 0, read_from_range, &rr, begin, sc->first_row);
+    *size = rr.offset - begin;
+}
+
+///////////////////////////////////////////
+///
+/// Following
+///
+
+// A file that's followed is kept open, so what's written to it after it's rotated (renamed or deleted) is still
+// searched before the new file at its path is opened
+struct ng_follower {
+    char *path;
+    int fd; // -1 while there's no file at the path
+    uint64_t offset; // Where the first line that's not searched yet starts
+    uint64_t row;
+};
+
+// The last line isn't searched until its newline is written, it's read again from `offset` next time instead
+// This function returns uint64_t which is where the line after the last newline before `size` starts
+uint64_t follower_complete_end(SearchContext *sc, int fd, uint64_t offset, uint64_t size)
+{
+    uint64_t end = size;
+    while(end > offset) {
+        size_t count = end - offset < sc->readbufsz ? (size_t)(end - offset) : sc->readbufsz;
+        if(btkfs_read_file_at(fd, sc->readbuf, count, end - count) != (long long)count) return offset;
+        for(size_t i = count; i > 0; --i) {
+            if(sc->readbuf[i - 1] == '\n') return end - count + i;
+        }
+        end -= count;
+    }
+    return offset;
+}
+
+// Search what's appended to the followed file since the last time. A smaller file is truncated and it's searched
+// from its start again. Once another file is at the path, the rest of the old one is searched (even its last line
+// without a newline, nothing is written to it anymore) and then the new one from its start
+void search_in_follower(SearchContext *sc, ng_follower_t *f)
+{
+    sc_set_file_path(sc, f->path);
+    while(!sc->stopped) {
+        if(f->fd < 0) {
+            f->fd = btkfs_open_file(f->path);
+            if(f->fd < 0) return;
+            f->offset = 0;
+            f->row = 0;
+        }
+        btkfs_file_id_t id, current;
+        if(btkfs_get_fd_id(&id, f->fd) != 0) return;
+        if(id.size < f->offset) {
+            f->offset = 0;
+            f->row = 0;
+        }
+        // While the path is renamed and not created again the old file could still be written to
+        bool rotated = btkfs_get_file_id(&current, f->path) == 0 && (current.device != id.device || current.inode != id.inode);
+        uint64_t end = rotated ? id.size : follower_complete_end(sc, f->fd, f->offset, id.size);
+        if(end > f->offset) {
+            RangeReader rr = { .fd = f->fd, .offset = f->offset, .end = end };
+            f->row = search_in_stream_from(sc, 0, read_from_range, &rr, f->offset, f->row);
+            btk_arena_reset(&sc->in_file);
+            sc->stats.bytes += end - f->offset;
+            f->offset = end;
+        }
+        if(!rotated) return;
+        btkfs_close_file(f->fd);
+        f->fd = -1;
+    }
+}
+
+///////////////////////////////////////////
+///
+/// Prefetching
+///
+
+// The prefetch history only has to tell the files of a search apart, a file of the directory search is known
+// by its parent and its name
+uint64_t sc_node_key(const SearchContext *sc, uint32_t node)
+{
+    const PathNode *pn = &sc->paths.items[node];
+    return hash_path_bytes(HASH_SEED ^ pn->parent, pn->name, pn->name_len);
+}
+
+uint64_t sc_file_key(SearchContext *sc)
+{
+    if(sc->file.node != PATH_NODE_NONE) return sc_node_key(sc, sc->file.node);
+    btk_stringview_t path = sc_file_path(sc);
+    return hash_path_bytes(HASH_SEED, path.data, path.count);
+}
+
+// Ask the OS to read the file into the page cache in the background while the files before it are searched
+void sc_prefetch(SearchContext *sc, int fd, uint64_t key)
+{
+    if(btkfs_advise_fd(fd, BTKFS_ADVICE_WILLNEED) != 0) return;
+    sc->stats.prefetched += 1;
+    sc->prefetch_history[sc->prefetch_history_count++ % PREFETCH_HISTORY_SIZE] = key;
+}
+
+void sc_prefetch_node(SearchContext *sc, int dirfd, uint32_t node)
+{
+    int fd = dirfd >= 0 ? btkfs_open_file_at(dirfd, sc->paths.items[node].name) : btkfs_open_file(sc_node_path(sc, node).data);
+    if(fd < 0) return;
+    sc_prefetch(sc, fd, sc_node_key(sc, node));
+    btkfs_close_file(fd);
+}
+
+bool sc_was_prefetched(const SearchContext *sc, uint64_t key)
+{
+    size_t count = sc->prefetch_history_count < PREFETCH_HISTORY_SIZE ? sc->prefetch_history_count : PREFETCH_HISTORY_SIZE;
+    for(size_t i = 0; i < count; ++i) {
+        if(sc->prefetch_history[i] == key) return true;
+    }
+    return false;
+}
+
+// The file is read straight into the window with a single read, without stdio and without asking for its size.
+// Most of the files of a source tree fit in it, so they're searched right there for an open, two reads (the last
+// one is the end of the file) and a close. Only the files that don't fit could be chunked so only they need the size.
+// This function returns bool which is false if the file couldn't be opened
+bool search_in_opened_file(SearchContext *sc, int fd, uint64_t *size)
+{
+    FileReader fr = { .fd = fd };
+    size_t filled = read_from_fd(&fr, sc->readbuf, sc->readbufsz);
+    CompressionKind kind = detect_compression((const unsigned char *)sc->readbuf, filled);
+    sc->cached.offsets_valid = kind == COMPRESSION_NONE;
+    if(kind == COMPRESSION_NONE && !sc->pattern->bytes_mode) {
+        TextEncoding encoding = detect_encoding((const unsigned char *)sc->readbuf, filled);
+        if(encoding != ENCODING_UTF8) {
+            sc->cached.offsets_valid = false;
+            return search_in_utf16_file(sc, &fr, filled, encoding == ENCODING_UTF16BE, size);
+        }
+    }
+    bool whole_buffer = sc->pattern->bytes_mode || sc->before_context > 0 || sc->after_context > 0;
+    if(kind == COMPRESSION_NONE && !whole_buffer && sc->row_range) {
+        search_in_file_rows(sc, fd, size);
+        btk_arena_reset(&sc->in_file);
+        return true;
+    }
+    if(kind == COMPRESSION_NONE && !whole_buffer) {
+        bool chunked = filled == sc->readbufsz && !sc->invert_match && sc->thread_count > 1 && btkfs_get_fd_size(fd) >= sc->chunk_threshold;
+        if(!chunked) {
+            search_in_stream(sc, filled, read_from_fd, &fr);
+            btk_arena_reset(&sc->in_file);
+            *size = fr.total;
+            return true;
+        }
+    } else if(kind != COMPRESSION_NONE && !sc->pattern->bytes_mode) {
+        // The window is reused for the decompressed data, so the compressed bytes already in it are copied out
+        // and given to the decompressor before the rest of the fd. The decompressed data isn't mapped anywhere,
+        // so compressed files are searched without the context
+        PrefixedReader pr = {
+            .prefix = { .data = btk_sv_from_parts(btk_arena_bufdup(&sc->in_file, sc->readbuf, filled), filled) },
+            .read_fn = read_from_fd,
+            .user = &fr,
+        };
+        search_in_compressed_file(sc, read_from_prefixed, &pr, kind);
+        btk_arena_reset(&sc->in_file);
+        *size = btkfs_get_fd_size(fd);
+        return true;
+    } else if(kind == COMPRESSION_NONE && filled < sc->readbufsz
+            && read_from_fd(&fr, sc->readbuf + filled, sc->readbufsz - filled) == 0) {
+        btk_stringview_t data = btk_sv_from_parts(sc->readbuf, filled);
+        if(sc->pattern->bytes_mode) search_in_buffer2(sc, data);
+        else search_in_buffer_with_context(sc, data);
+        btk_arena_reset(&sc->in_file);
+        *size = filled;
+        return true;
+    }
+
+    // The rest is mapped or read again from its start through the same fd, so it's the file that was sniffed
+    *size = btkfs_get_fd_size(fd);
+    if(sc->pattern->bytes_mode) {
+        return search_in_file2(sc, fd);
+    } else if(sc->before_context > 0 || sc->after_context > 0) {
+        return search_in_file_with_context(sc, fd);
+    } else {
+        return search_in_file_chunked(sc, fd);
+    }
+}
+
+// Deliver the matches of a file from the result cache, their previews are read at their offsets. A file without
+// a match isn't even opened
+// This function returns bool which is false if the file isn't in the cache
+bool search_in_cached_file(SearchContext *sc, const btkfs_file_id_t *id)
+{
+    CacheRecord *records;
+    size_t count;
+    if(!cache_lookup(sc->cache, sc->pattern->cache_key, id, &sc->in_file, &records, &count)) return false;
+    int fd = count > 0 ? sc_open_file(sc) : -1;
+    if(count > 0 && fd < 0) {
+        btk_arena_reset(&sc->in_file);
+        return false;
+    }
+    sc->stats.cache_hits += 1;
+    for(size_t i = 0; i < count && !sc->stopped; ++i) {
+        CacheRecord rec = records[i];
+        char *preview = rec.preview_len <= sc->readbufsz ? sc->readbuf : btk_arena_alloc(&sc->in_file, rec.preview_len);
+        // The file is changed after it's looked up, what's left of it isn't known anymore
+        if(btkfs_read_file_at(fd, preview, rec.preview_len, rec.preview_offset) != (long long)rec.preview_len) break;
+        sc->find_count += 1;
+        sc_emit(sc, NG_RECORD_MATCH, (SearchResult){
+            .row = rec.row,
+            .col = rec.col,
+            .offset = rec.offset,
+            .line_offset = rec.line_offset,
+            .len = rec.len,
+            .preview_offset = rec.preview_offset,
+            .preview = btk_sv_from_parts(preview, rec.preview_len),
+        });
+    }
+    if(fd >= 0) btkfs_close_file(fd);
+    btk_arena_reset(&sc->in_file);
+    return true;
+}
+
+// The matches are only stored if all of them were delivered and their previews could be read from the file again
+void sc_cache_store(SearchContext *sc, const btkfs_file_id_t *id, uint64_t size)
+{
+    if(sc->stopped || sc->cached.skipped || sc->cached.count > CACHE_MAX_RECORDS_PER_FILE) return;
+    if(sc->cached.count > 0 && (!sc->cached.offsets_valid || size != id->size)) return;
+    cache_store(sc->cache, sc->pattern->cache_key, id, sc->cached.items, sc->cached.count);
+}
+
+// Search the file set with sc_set_file_path() or sc_set_file_node(). A file that surely has no match by its Bloom
+// filter or an unchanged file that's in the result cache isn't read
+// This function returns bool which is false if the file couldn't be opened
+bool search_in_file(SearchContext *sc)
+{
+    assert(sc && "Invalid sc pointer");
+    btkfs_file_id_t id;
+    bool has_id = (sc->cache != NULL || sc->bloom != NULL) && sc_get_file_id(sc, &id);
+    if(has_id && sc->bloom != NULL) {
+        const BloomEntry *entry = bloom_lookup(sc->bloom, &id);
+        if(entry != NULL && !bloom_may_contain(sc->bloom, entry, sc->pattern->gram_hashes, sc->pattern->gram_count)) {
+            sc->stats.bloom_skipped += 1;
+            return true;
+        }
+    }
+    bool cacheable = has_id && sc->cache != NULL;
+    if(cacheable && search_in_cached_file(sc, &id)) return true;
+    sc->cached.count = 0;
+    sc->cached.skipped = false;
+    int fd = sc_open_file(sc);
+    if(fd < 0) return false;
+    if(sc->collect_stats && sc_was_prefetched(sc, sc_file_key(sc))) {
+        uint64_t size = btkfs_get_fd_size(fd);
+        uint64_t checked = size < PREFETCH_HIT_CHECK_SIZE ? size : PREFETCH_HIT_CHECK_SIZE;
+        if(btkfs_is_fd_cached(fd, checked)) sc->stats.prefetch_hits += 1;
+    }
+    uint64_t size = 0;
+    bool searched = search_in_opened_file(sc, fd, &size);
+    if(searched) {
+        sc->stats.files += 1;
+        sc->stats.bytes += size;
+        if(sc->drop_cache_threshold > 0 && size >= sc->drop_cache_threshold) {
+            if(btkfs_advise_fd(fd, BTKFS_ADVICE_DONTNEED) == 0) sc->stats.dropped += 1;
+        }
+        if(cacheable) sc_cache_store(sc, &id, size);
+    }
+    btkfs_close_file(fd);
+    return searched;
+}
+
+// TODO(bagasjs): Evaluating .gitignore content if it exists in the directory
+// The entries of a directory are listed first, so the next `prefetch_depth` files could be read into the page
+// cache by the OS while the current one is searched. They're nodes of the path tree that are opened relative
+// to the opened directory, so the full paths are only made for the files with something to deliver
+void inner_search_in_dir(SearchContext *sc, uint32_t dir_node, int parent_fd)
+{
+    assert(sc && "Invalid sc pointer");
+    struct dirent *ep = NULL;
+
+#ifdef _WIN32
+    // There's no *at() functions, everything is opened by its full path
+    (void)parent_fd;
+    int dirfd = -1;
+    DIR *dp = opendir(sc_node_path(sc, dir_node).data);
+#else
+    const char *dir_name = sc->paths.items[dir_node].name;
+    int dirfd = parent_fd >= 0 ? btkfs_open_dir_at(parent_fd, dir_name) : btkfs_open_dir(dir_name);
+    // The directory stream owns the file descriptor, it's closed by closedir()
+    DIR *dp = dirfd >= 0 ? fdopendir(dirfd) : NULL;
+    if(dp == NULL && dirfd >= 0) btkfs_close_file(dirfd);
+#endif
+    if(dp == NULL) return;
+    size_t first = sc->paths.count;
+    while((ep=readdir(dp)) != NULL) {
+        bool is_cwd_or_parent = strncmp(ep->d_name, ".", sizeof(ep->d_name)) == 0 
+            || strncmp(ep->d_name, "..", sizeof(ep->d_name)) == 0;
+        if(is_cwd_or_parent) continue;
+        uint32_t node = sc_push_path(sc, dir_node, ep->d_name, strlen(ep->d_name), false);
+        bool is_dir;
+#ifdef _DIRENT_HAVE_D_TYPE
+        // The type in the entry saves a stat, only a symlink needs one to know what it points to
+        if(ep->d_type != DT_UNKNOWN && ep->d_type != DT_LNK) is_dir = ep->d_type == DT_DIR;
+        else
+#endif
+        is_dir = dirfd >= 0 ? btkfs_isdir_at(dirfd, ep->d_name) : btkfs_isdir(sc_node_path(sc, node).data);
+        sc->paths.items[node].is_dir = is_dir;
+    }
+    size_t end = sc->paths.count;
+
+    size_t next_prefetch = first; // The files before this entry are prefetched already
+    int in_flight = 0; // Prefetched files that are not searched yet
+    for(size_t i = first; i < end && !sc->stopped; ++i) {
+        if(sc->paths.items[i].is_dir) {
+            inner_search_in_dir(sc, (uint32_t)i, dirfd);
+            continue;
+        }
+        if(i < next_prefetch) in_flight -= 1;
+        else next_prefetch = i + 1;
+        for(; in_flight < sc->prefetch_depth && next_prefetch < end; ++next_prefetch) {
+            if(sc->paths.items[next_prefetch].is_dir) continue;
+            sc_prefetch_node(sc, dirfd, (uint32_t)next_prefetch);
+            in_flight += 1;
+        }
+        sc_set_file_node(sc, dirfd, (uint32_t)i);
+        search_in_file(sc);
+    }
+    closedir(dp);
+}
+
+void search_in_dir(SearchContext *sc, btk_stringview_t dirpath)
+{
+    assert(sc && "Invalid sc pointer");
+    uint32_t root = sc_push_path(sc, PATH_NODE_NONE, dirpath.data, dirpath.count, true);
+    inner_search_in_dir(sc, root, -1);
+    sc->paths.items = NULL;
+    sc->paths.count = 0;
+    sc->paths.capacity = 0;
+    btk_arena_reset(&sc->in_dir);
+}
+
+///////////////////////////////////////////
+///
+/// Public API
+///
+
+ng_pattern_options_t ng_pattern_default_options(void)
+{
+    ng_pattern_options_t options = {0};
+    return options;
+}
+
+ng_search_options_t ng_search_default_options(void)
+{
+    ng_search_options_t options = {0};
+    options.thread_count = 1;
+    options.chunk_threshold = CHUNKED_SCAN_THRESHOLD;
+    options.prefetch_depth = DEFAULT_PREFETCH_DEPTH;
+    options.drop_cache_threshold = DROP_CACHE_THRESHOLD;
+    return options;
+}
+
+int ng_pattern_compile(ng_pattern_t **pattern, const char *text, size_t text_len, const ng_pattern_options_t *options)
+{
+    if(pattern == NULL || (text == NULL && text_len > 0)) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_pattern_options_t opts = options ? *options : ng_pattern_default_options();
+    ng_pattern_t *result = malloc(sizeof(ng_pattern_t));
+    if(result == NULL) return NG_ERROR_UNKNOWN;
+    *result = (ng_pattern_t){0};
+    result->bytes_mode = opts.bytes_mode != 0;
+    bool fuzzy_invalid = opts.max_errors > 0 && (text_len == 0 || opts.max_errors >= text_len || text_len > FUZZY_MAX_PATTERN_SIZE);
+    bool glob_invalid = opts.glob && (result->bytes_mode || opts.max_errors > 0);
+    if((result->bytes_mode && (opts.whole_word || opts.whole_line || opts.max_errors > 0)) || fuzzy_invalid || glob_invalid) {
+        free(result);
+        return NG_ERROR_INVALID_ARGUMENTS;
+    }
+    result->boundary = opts.whole_line ? BOUNDARY_LINE : opts.whole_word ? BOUNDARY_WORD : BOUNDARY_NONE;
+    for(int ch = 0; ch < 256; ++ch) {
+        result->word_bytes[ch] = ch >= 0x80 || ch == '_' || (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+    }
+    // The caller's text may be gone while the pattern is still used
+    result->text = btk_sv_from_parts(btk_arena_bufdup(&result->arena, text_len > 0 ? text : "", text_len), text_len);
+    result->find_literal = choose_literal_finder(text_len);
+    if(result->bytes_mode && !parse_byte_pattern(&result->arena, result->text, &result->byte_pattern)) {
+        ng_pattern_free(result);
+        return NG_ERROR_INVALID_PATTERN;
+    }
+    result->glob = opts.glob != 0;
+    if(result->glob && !parse_glob_pattern(&result->arena, result->text, &result->glob_pattern)) {
+        ng_pattern_free(result);
+        return NG_ERROR_INVALID_PATTERN;
+    }
+    // --jit doesn't change what's matched
+    result->cache_key = hash_path_bytes(HASH_SEED, result->text.data, result->text.count);
+    result->cache_key = cache_mix(result->cache_key, (uint64_t)result->bytes_mode | (uint64_t)result->boundary << 1 | (uint64_t)result->glob << 3);
+    result->cache_key = cache_mix(result->cache_key, opts.max_errors);
+#ifdef NOTGREP_JIT
+    if(result->glob && glob_build_dfa(&result->arena, &result->glob_pattern) && opts.jit) glob_compile_jit(&result->glob_pattern);
+#else
+    if(result->glob) glob_build_dfa(&result->arena, &result->glob_pattern);
+#endif
+    if(opts.max_errors > 0) {
+        result->fuzzy = true;
+        fuzzy_pattern_init(&result->arena, &result->fuzzy_pattern, result->text, opts.max_errors);
+    }
+    // A fuzzy match doesn't have to contain any of the bytes of the pattern
+    btk_stringview_t required = result->text;
+    if(result->fuzzy) required = BTK_SV_NULL;
+    else if(result->glob) required = result->glob_pattern.literal;
+    else if(result->bytes_mode) required = btk_sv_from_parts((const char *)result->byte_pattern.bytes + result->byte_pattern.anchor_offset, result->byte_pattern.anchor_count);
+    if(required.count >= BLOOM_GRAM_SIZE) {
+        result->gram_count = required.count - BLOOM_GRAM_SIZE + 1;
+        result->gram_hashes = btk_arena_alloc(&result->arena, result->gram_count*sizeof(uint64_t));
+        for(size_t i = 0; i < result->gram_count; ++i) {
+            const unsigned char *at = (const unsigned char *)required.data + i;
+            result->gram_hashes[i] = bloom_gram_hash((uint32_t)at[0] << 16 | (uint32_t)at[1] << 8 | at[2]);
+        }
+    }
+    *pattern = result;
+    return NG_OK;
+}
+
+void ng_pattern_free(ng_pattern_t *pattern)
+{
+    if(pattern == NULL) return;
+    glob_pattern_free(&pattern->glob_pattern);
+    btk_arena_free(&pattern->arena);
+    free(pattern);
+}
+
+ng_searcher_t *ng_searcher_new(const ng_pattern_t *pattern, const ng_search_options_t *options, ng_match_fn on_match, void *user)
+{
+    if(pattern == NULL || on_match == NULL) return NULL;
+    ng_search_options_t opts = options ? *options : ng_search_default_options();
+    SearchContext *sc = malloc(sizeof(SearchContext));
+    if(sc == NULL) return NULL;
+    *sc = (SearchContext){0};
+    sc->pattern = pattern;
+    sc->thread_count = opts.thread_count;
+    sc->chunk_threshold = opts.chunk_threshold;
+    sc->before_context = opts.before_context;
+    sc->after_context = opts.after_context;
+    sc->prefetch_depth = opts.prefetch_depth;
+    sc->drop_cache_threshold = opts.drop_cache_threshold;
+    sc->collect_stats = opts.collect_stats != 0;
+    // The inverted search is line by line, the context lines and the byte patterns don't go with it
+    sc->invert_match = opts.invert_match != 0 && !pattern->bytes_mode;
+    if(sc->invert_match) {
+        sc->before_context = 0;
+        sc->after_context = 0;
+    }
+    // Only the matches are cached, not the lines around them or between them
+    if(opts.cache != NULL && !sc->invert_match && sc->before_context == 0 && sc->after_context == 0) sc->cache = opts.cache;
+    // A file without a match still has lines to deliver with -v
+    if(opts.bloom != NULL && !sc->invert_match && pattern->gram_count > 0) sc->bloom = opts.bloom;
+    // The rows are only known by counting, a byte pattern doesn't count them
+    sc->row_range = (opts.first_row > 0 || opts.row_count > 0) && !sc->invert_match && !pattern->bytes_mode
+        && sc->before_context == 0 && sc->after_context == 0;
+    if(sc->row_range) {
+        sc->first_row = opts.first_row;
+        sc->last_row = opts.row_count > 0 && opts.row_count - 1 <= UINT64_MAX - opts.first_row ? opts.first_row + opts.row_count - 1 : UINT64_MAX;
+        // The cache has the matches of the whole file
+        sc->cache = NULL;
+    }
+    sc->on_match = on_match;
+    sc->user = user;
+    sc_set_file_path(sc, "");
+    sc->readbufsz = STREAM_WINDOW_SIZE;
+    if(sc->readbufsz < pattern->text.count*4) sc->readbufsz = pattern->text.count*4;
+    sc->readbuf = btk_arena_alloc(&sc->in_life, sc->readbufsz);
+    if(sc->cache != NULL) sc->cached.items = btk_arena_alloc(&sc->in_life, CACHE_MAX_RECORDS_PER_FILE*sizeof(CacheRecord));
+    return sc;
+}
+
+void ng_searcher_free(ng_searcher_t *searcher)
+{
+    if(searcher == NULL) return;
+    btk_arena_free(&searcher->in_life);
+    btk_arena_free(&searcher->in_dir);
+    btk_arena_free(&searcher->in_file);
+    btk_arena_free(&searcher->in_results);
+    free(searcher);
+}
+
+// The buffer is searched as it is, a compressed buffer isn't decompressed
+int ng_search_buffer(ng_searcher_t *searcher, const char *name, const char *data, size_t size)
+{
+    if(searcher == NULL || (data == NULL && size > 0)) return NG_ERROR_INVALID_ARGUMENTS;
+    SearchContext *sc = searcher;
+    sc->stopped = false;
+    sc_set_file_path(sc, name ? name : "");
+    btk_stringview_t buffer = btk_sv_from_parts(data, size);
+    if(sc->pattern->bytes_mode) {
+        search_in_buffer2(sc, buffer);
+    } else if(sc->invert_match) {
+        MemoryReader mr = { .data = buffer };
+        search_in_stream(sc, 0, read_from_memory, &mr);
+    } else if(sc->before_context > 0 || sc->after_context > 0) {
+        search_in_buffer_with_context(sc, buffer);
+    } else {
+        bool chunked = sc->thread_count > 1 && size >= sc->chunk_threshold;
+        search_in_buffer_chunked(sc, buffer, chunked ? (size_t)sc->thread_count : 1);
+    }
+    btk_arena_reset(&sc->in_file);
+    return sc->stopped ? NG_ERROR_STOPPED : NG_OK;
+}
+
+int ng_search_file(ng_searcher_t *searcher, const char *filepath)
+{
+    if(searcher == NULL || filepath == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    searcher->stopped = false;
+    sc_set_file_path(searcher, filepath);
+    if(!search_in_file(searcher)) return NG_ERROR_COULDNT_OPEN;
+    return searcher->stopped ? NG_ERROR_STOPPED : NG_OK;
+}
+
+int ng_search_dir(ng_searcher_t *searcher, const char *dirpath)
+{
+    if(searcher == NULL || dirpath == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    if(!btkfs_isdir(dirpath)) return NG_ERROR_COULDNT_OPEN;
+    searcher->stopped = false;
+    search_in_dir(searcher, btk_sv_from_cstr(dirpath));
+    return searcher->stopped ? NG_ERROR_STOPPED : NG_OK;
+}
+
+int ng_search_stream(ng_searcher_t *searcher, const char *name, ng_read_fn read_fn, void *user)
+{
+    if(searcher == NULL || read_fn == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    SearchContext *sc = searcher;
+    sc->stopped = false;
+    if(!sc->pattern->bytes_mode && sc->before_context == 0 && sc->after_context == 0) {
+        sc_set_file_path(sc, name ? name : "");
+        search_in_stream(sc, 0, read_fn, user);
+        return sc->stopped ? NG_ERROR_STOPPED : NG_OK;
+    }
+
+    // The context lines and the byte patterns are searched in a whole buffer
+    size_t count;
+    char *data = read_all(read_fn, user, sc->readbufsz, &count);
+    if(data == NULL) return NG_ERROR_UNKNOWN;
+    int result = ng_search_buffer(sc, name, data, count);
+    free(data);
+    return result;
+}
+
+void ng_prefetch_file(ng_searcher_t *searcher, const char *filepath)
+{
+    if(searcher == NULL || filepath == NULL) return;
+    int fd = btkfs_open_file(filepath);
+    if(fd < 0) return;
+    btk_stringview_t path = btk_sv_from_cstr(filepath);
+    sc_prefetch(searcher, fd, hash_path_bytes(HASH_SEED, path.data, path.count));
+    btkfs_close_file(fd);
+}
+
+int ng_cache_open(ng_cache_t **cache, const char *path, uint64_t max_size)
+{
+    if(cache == NULL || path == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    if(max_size < CACHE_MIN_SIZE) max_size = CACHE_MIN_SIZE;
+    ng_cache_t *result = malloc(sizeof(ng_cache_t));
+    if(result == NULL) return NG_ERROR_UNKNOWN;
+    if(btkfs_map_shared_file(&result->file, path, max_size & ~(uint64_t)7) != 0) {
+        free(result);
+        return NG_ERROR_COULDNT_OPEN;
+    }
+    if(!cache_is_valid(result)) cache_reset(result);
+    btk_mutex_init(&result->mutex);
+    *cache = result;
+    return NG_OK;
+}
+
+void ng_cache_close(ng_cache_t *cache)
+{
+    if(cache == NULL) return;
+    btk_mutex_destroy(&cache->mutex);
+    btkfs_unmap_shared_file(&cache->file);
+    free(cache);
+}
+
+// The number of bits for a false positive rate p is n*log2(1/p)/ln(2) with log2(1/p) hashes, the hashes are
+// rounded up so there's no need for libm
+ng_bloom_builder_t *ng_bloom_builder_new(double false_positive_rate)
+{
+    if(!(false_positive_rate > 0.0 && false_positive_rate < 1.0)) return NULL;
+    ng_bloom_builder_t *b = malloc(sizeof(ng_bloom_builder_t));
+    if(b == NULL) return NULL;
+    *b = (ng_bloom_builder_t){0};
+    double rate = 1.0;
+    while(rate > false_positive_rate && b->hash_count < BLOOM_MAX_HASHES) {
+        rate /= 2.0;
+        b->hash_count += 1;
+    }
+    b->bits_per_gram = (double)b->hash_count*1.4426950408889634;
+    b->seen = calloc((1u << 24)/64, sizeof(uint64_t));
+    b->readbuf = malloc(BLOOM_READ_SIZE);
+    if(b->seen == NULL || b->readbuf == NULL) {
+        ng_bloom_builder_free(b);
+        return NULL;
+    }
+    return b;
+}
+
+void ng_bloom_builder_free(ng_bloom_builder_t *builder)
+{
+    if(builder == NULL) return;
+    free(builder->seen);
+    free(builder->grams.items);
+    free(builder->entries.items);
+    free(builder->words.items);
+    free(builder->readbuf);
+    free(builder->pathbuf);
+    free(builder);
+}
+
+// The file is read once in big blocks and its distinct grams are collected, then the filter is made for their
+// count. A compressed or a UTF-16 file doesn't have the grams of the text that's searched, it gets no filter
+int ng_bloom_add_file(ng_bloom_builder_t *builder, const char *filepath)
+{
+    if(builder == NULL || filepath == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_bloom_builder_t *b = builder;
+    btkfs_file_id_t id;
+    if(btkfs_get_file_id(&id, filepath) != 0) return NG_ERROR_COULDNT_OPEN;
+    int fd = btkfs_open_file(filepath);
+    if(fd < 0) return NG_ERROR_COULDNT_OPEN;
+    bool plain = true;
+    bool ok = true;
+    uint32_t gram = 0;
+    uint64_t total = 0;
+    long long n = 0;
+    while(ok && (n = btkfs_read_file(fd, b->readbuf, BLOOM_READ_SIZE)) > 0) {
+        const unsigned char *data = (const unsigned char *)b->readbuf;
+        if(total == 0) plain = detect_compression(data, (size_t)n) == COMPRESSION_NONE && detect_encoding(data, (size_t)n) == ENCODING_UTF8;
+        if(!plain) break;
+        ok = bloom_collect_grams(b, data, (size_t)n, &gram, total);
+        total += (uint64_t)n;
+    }
+    btkfs_close_file(fd);
+    if(n < 0) ok = false;
+
+    // The filter has at most as many bytes as the file
+    uint64_t bit_count = 0;
+    if(plain && ok) {
+        bit_count = (uint64_t)((double)b->grams.count*b->bits_per_gram) + 1;
+        if(bit_count > total*8) bit_count = total*8;
+        bit_count = (bit_count + 63)/64*64;
+        if(bit_count == 0) bit_count = 64;
+    }
+    size_t word_count = (size_t)(bit_count/64);
+    ok = ok && grow_array((void **)&b->words.items, &b->words.capacity, b->words.count + word_count, sizeof(uint64_t))
+        && grow_array((void **)&b->entries.items, &b->entries.capacity, b->entries.count + 1, sizeof(BloomEntry));
+    if(ok) {
+        uint64_t *words = b->words.items + b->words.count;
+        memset(words, 0, word_count*sizeof(uint64_t));
+        for(size_t i = 0; i < b->grams.count && bit_count > 0; ++i) {
+            uint64_t hash = bloom_gram_hash(b->grams.items[i]);
+            for(uint32_t j = 0; j < b->hash_count; ++j) {
+                uint64_t bit = bloom_bit(hash, j, bit_count);
+                words[bit >> 6] |= 1ull << (bit & 63);
+            }
+        }
+        b->entries.items[b->entries.count++] = (BloomEntry){
+            .device = id.device,
+            .inode = id.inode,
+            .size = id.size,
+            .mtime_ns = id.mtime_ns,
+            .words = b->words.count,
+            .bit_count = bit_count,
+        };
+        b->words.count += word_count;
+    }
+    for(size_t i = 0; i < b->grams.count; ++i) b->seen[b->grams.items[i] >> 6] = 0;
+    b->grams.count = 0;
+    return ok ? NG_OK : NG_ERROR_UNKNOWN;
+}
+
+// A file that couldn't be read isn't indexed so it's always searched, same as a new file
+void bloom_add_walked_file(void *user, const char *filepath)
+{
+    ng_bloom_add_file(user, filepath);
+}
+
+int ng_bloom_add_dir(ng_bloom_builder_t *builder, const char *dirpath)
+{
+    if(builder == NULL || dirpath == NULL || dirpath[0] == 0) return NG_ERROR_INVALID_ARGUMENTS;
+    if(!btkfs_isdir(dirpath)) return NG_ERROR_COULDNT_OPEN;
+    size_t len = strlen(dirpath);
+    if(!grow_array((void **)&builder->pathbuf, &builder->pathbufsz, len + 1, sizeof(char))) return NG_ERROR_UNKNOWN;
+    memcpy(builder->pathbuf, dirpath, len + 1);
+    walk_dir(&builder->pathbuf, &builder->pathbufsz, len, bloom_add_walked_file, builder);
+    return NG_OK;
+}
+
+int ng_bloom_write(ng_bloom_builder_t *builder, const char *path)
+{
+    if(builder == NULL || path == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_bloom_builder_t *b = builder;
+    qsort(b->entries.items, b->entries.count, sizeof(BloomEntry), bloom_entry_compare);
+    BloomHeader header = {
+        .magic = BLOOM_MAGIC,
+        .hash_count = b->hash_count,
+        .entry_count = b->entries.count,
+        .word_count = b->words.count,
+    };
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) return NG_ERROR_COULDNT_OPEN;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(b->entries.items, sizeof(BloomEntry), b->entries.count, fp) == b->entries.count
+        && fwrite(b->words.items, sizeof(uint64_t), b->words.count, fp) == b->words.count;
+    if(fclose(fp) != 0) ok = false;
+    return ok ? NG_OK : NG_ERROR_UNKNOWN;
+}
+
+ng_suffix_array_builder_t *ng_suffix_array_builder_new(void)
+{
+    ng_suffix_array_builder_t *b = malloc(sizeof(ng_suffix_array_builder_t));
+    if(b == NULL) return NULL;
+    *b = (ng_suffix_array_builder_t){0};
+    return b;
+}
+
+void ng_suffix_array_builder_free(ng_suffix_array_builder_t *builder)
+{
+    if(builder == NULL) return;
+    free(builder->docs.items);
+    free(builder->paths.items);
+    free(builder->pathbuf);
+    free(builder);
+}
+
+// Only the path and the size are taken now, the files are read when the index is written
+int ng_suffix_array_add_file(ng_suffix_array_builder_t *builder, const char *filepath)
+{
+    if(builder == NULL || filepath == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_suffix_array_builder_t *b = builder;
+    btkfs_file_id_t id;
+    if(btkfs_get_file_id(&id, filepath) != 0) return NG_ERROR_COULDNT_OPEN;
+    size_t path_len = strlen(filepath);
+    if(!grow_array((void **)&b->docs.items, &b->docs.capacity, b->docs.count + 1, sizeof(SuffixArrayDoc))
+            || !grow_array((void **)&b->paths.items, &b->paths.capacity, b->paths.count + path_len + 1, sizeof(char))) {
+        return NG_ERROR_UNKNOWN;
+    }
+    b->docs.items[b->docs.count++] = (SuffixArrayDoc){ .size = id.size, .path = b->paths.count };
+    memcpy(b->paths.items + b->paths.count, filepath, path_len + 1);
+    b->paths.count += path_len + 1;
+    return NG_OK;
+}
+
+void suffix_array_add_walked_file(void *user, const char *filepath)
+{
+    ng_suffix_array_add_file(user, filepath);
+}
+
+int ng_suffix_array_add_dir(ng_suffix_array_builder_t *builder, const char *dirpath)
+{
+    if(builder == NULL || dirpath == NULL || dirpath[0] == 0) return NG_ERROR_INVALID_ARGUMENTS;
+    if(!btkfs_isdir(dirpath)) return NG_ERROR_COULDNT_OPEN;
+    size_t len = strlen(dirpath);
+    if(!grow_array((void **)&builder->pathbuf, &builder->pathbufsz, len + 1, sizeof(char))) return NG_ERROR_UNKNOWN;
+    memcpy(builder->pathbuf, dirpath, len + 1);
+    walk_dir(&builder->pathbuf, &builder->pathbufsz, len, suffix_array_add_walked_file, builder);
+    return NG_OK;
+}
+
+// The text and the suffix array are made right in a shared mapping of the index, so the OS writes them to the
+// index instead of the swap when the corpus doesn't fit in the memory. The newlines are only counted after the text
+// is read, the index is mapped again with room for them
+int ng_suffix_array_write(ng_suffix_array_builder_t *builder, const char *path)
+{
+    if(builder == NULL || path == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_suffix_array_builder_t *b = builder;
+    uint64_t text_size = 0;
+    for(size_t i = 0; i < b->docs.count; ++i) text_size += b->docs.items[i].size;
+    SuffixArrayHeader header = { .doc_count = b->docs.count };
+    header.paths_offset = sizeof(SuffixArrayHeader) + b->docs.count*sizeof(SuffixArrayDoc);
+    header.text_offset = header.paths_offset + (b->paths.count + 7)/8*8;
+    header.sa_offset = header.text_offset + (text_size + 7)/8*8;
+    header.lines_offset = header.sa_offset + (text_size + 1)*sizeof(int64_t);
+    if((size_t)header.lines_offset != header.lines_offset) return NG_ERROR_INVALID_ARGUMENTS;
+
+    btkfs_shared_file_t sf;
+    if(btkfs_map_shared_file(&sf, path, header.lines_offset) != 0) return NG_ERROR_COULDNT_OPEN;
+    memset(sf.data, 0, sizeof(SuffixArrayHeader));
+    memcpy(sf.data + header.paths_offset, b->paths.items, b->paths.count);
+    // A file that's shorter than it was is taken as it is now, the rest of the text is just not used
+    char *text = sf.data + header.text_offset;
+    for(size_t i = 0; i < b->docs.count; ++i) {
+        SuffixArrayDoc *doc = &b->docs.items[i];
+        uint64_t wanted = doc->size;
+        doc->start = header.text_size;
+        doc->size = 0;
+        int fd = btkfs_open_file(b->paths.items + doc->path);
+        if(fd < 0) continue;
+        long long n;
+        while(doc->size < wanted && (n = btkfs_read_file(fd, text + doc->start + doc->size, (size_t)(wanted - doc->size))) > 0) {
+            doc->size += (uint64_t)n;
+        }
+        btkfs_close_file(fd);
+        header.text_size += doc->size;
+    }
+    bool ok = build_suffix_array((const unsigned char *)text, header.text_size, (int64_t *)(sf.data + header.sa_offset));
+    for(uint64_t i = 0; ok && i < header.text_size; ++i) {
+        if(text[i] == '\n') header.line_count += 1;
+    }
+    btkfs_unmap_shared_file(&sf);
+    if(!ok) return NG_ERROR_UNKNOWN;
+
+    if(btkfs_map_shared_file(&sf, path, header.lines_offset + header.line_count*sizeof(uint64_t)) != 0) return NG_ERROR_COULDNT_OPEN;
+    text = sf.data + header.text_offset;
+    uint64_t *lines = (uint64_t *)(sf.data + header.lines_offset);
+    size_t doc = 0;
+    uint64_t line = 0;
+    for(uint64_t i = 0; i < header.text_size; ++i) {
+        for(; doc < b->docs.count && b->docs.items[doc].start <= i; ++doc) b->docs.items[doc].first_line = line;
+        if(text[i] == '\n') lines[line++] = i;
+    }
+    for(; doc < b->docs.count; ++doc) b->docs.items[doc].first_line = line;
+    memcpy(sf.data + sizeof(SuffixArrayHeader), b->docs.items, b->docs.count*sizeof(SuffixArrayDoc));
+    header.magic = SUFFIX_ARRAY_MAGIC;
+    memcpy(sf.data, &header, sizeof(header));
+    btkfs_unmap_shared_file(&sf);
+    return NG_OK;
+}
+
+int ng_suffix_array_open(ng_suffix_array_t **index, const char *path)
+{
+    if(index == NULL || path == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_suffix_array_t *result = malloc(sizeof(ng_suffix_array_t));
+    if(result == NULL) return NG_ERROR_UNKNOWN;
+    if(btkfs_map_file(&result->file, path) != 0) {
+        free(result);
+        return NG_ERROR_COULDNT_OPEN;
+    }
+    const SuffixArrayHeader *h = (const SuffixArrayHeader *)result->file.data;
+    uint64_t size = result->file.size;
+    bool valid = size >= sizeof(SuffixArrayHeader) && h->magic == SUFFIX_ARRAY_MAGIC
+        && h->doc_count <= (size - sizeof(SuffixArrayHeader))/sizeof(SuffixArrayDoc)
+        && h->paths_offset == sizeof(SuffixArrayHeader) + h->doc_count*sizeof(SuffixArrayDoc)
+        && h->paths_offset <= h->text_offset && h->text_offset <= h->sa_offset && h->text_size <= h->sa_offset - h->text_offset
+        && h->sa_offset <= h->lines_offset && h->lines_offset <= size
+        && (h->lines_offset - h->sa_offset)/sizeof(int64_t) > h->text_size
+        && h->line_count <= (size - h->lines_offset)/sizeof(uint64_t);
+    if(!valid) {
+        btkfs_unmap_file(&result->file);
+        free(result);
+        return NG_ERROR_INVALID_ARGUMENTS;
+    }
+    result->header = h;
+    result->docs = (const SuffixArrayDoc *)(h + 1);
+    result->paths = result->file.data + h->paths_offset;
+    result->text = (const unsigned char *)result->file.data + h->text_offset;
+    result->sa = (const int64_t *)(result->file.data + h->sa_offset);
+    result->lines = (const uint64_t *)(result->file.data + h->lines_offset);
+    *index = result;
+    return NG_OK;
+}
+
+void ng_suffix_array_close(ng_suffix_array_t *index)
+{
+    if(index == NULL) return;
+    btkfs_unmap_file(&index->file);
+    free(index);
+}
+
+int ng_search_suffix_array(ng_searcher_t *searcher, const ng_suffix_array_t *index)
+{
+    if(searcher == NULL || index == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    const ng_pattern_t *pattern = searcher->pattern;
+    if(pattern->bytes_mode || pattern->fuzzy || pattern->glob || pattern->text.count == 0) return NG_ERROR_INVALID_PATTERN;
+    searcher->stopped = false;
+    search_in_suffix_array(searcher, index);
+    return searcher->stopped ? NG_ERROR_STOPPED : NG_OK;
+}
+
+int ng_bloom_open(ng_bloom_t **bloom, const char *path)
+{
+    if(bloom == NULL || path == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    ng_bloom_t *result = malloc(sizeof(ng_bloom_t));
+    if(result == NULL) return NG_ERROR_UNKNOWN;
+    if(btkfs_map_file(&result->file, path) != 0) {
+        free(result);
+        return NG_ERROR_COULDNT_OPEN;
+    }
+    const BloomHeader *header = (const BloomHeader *)result->file.data;
+    bool valid = result->file.size >= sizeof(BloomHeader) && header->magic == BLOOM_MAGIC
+        && header->hash_count > 0 && header->hash_count <= BLOOM_MAX_HASHES
+        && header->entry_count <= (result->file.size - sizeof(BloomHeader))/sizeof(BloomEntry)
+        && header->word_count == (result->file.size - sizeof(BloomHeader) - header->entry_count*sizeof(BloomEntry))/sizeof(uint64_t);
+    if(!valid) {
+        btkfs_unmap_file(&result->file);
+        free(result);
+        return NG_ERROR_INVALID_ARGUMENTS;
+    }
+    result->hash_count = header->hash_count;
+    result->entries = (const BloomEntry *)(header + 1);
+    result->entry_count = (size_t)header->entry_count;
+    result->words = (const uint64_t *)(result->entries + result->entry_count);
+    result->word_count = header->word_count;
+    *bloom = result;
+    return NG_OK;
+}
+
+void ng_bloom_close(ng_bloom_t *bloom)
+{
+    if(bloom == NULL) return;
+    btkfs_unmap_file(&bloom->file);
+    free(bloom);
+}
+
+// An existing sidecar of the same file is read first, so only what's appended to the file since is read
+int ng_line_index_write(const char *filepath, uint32_t interval)
+{
+    if(filepath == NULL || interval == 0) return NG_ERROR_INVALID_ARGUMENTS;
+    btkfs_file_id_t id;
+    if(btkfs_get_file_id(&id, filepath) != 0) return NG_ERROR_COULDNT_OPEN;
+    int fd = btkfs_open_file(filepath);
+    if(fd < 0) return NG_ERROR_COULDNT_OPEN;
+    size_t path_len = strlen(filepath);
+    char *indexpath = malloc(path_len + sizeof(LINE_INDEX_EXTENSION));
+    char *buf = malloc(STREAM_WINDOW_SIZE);
+    struct {
+        uint64_t *items;
+        size_t count;
+        size_t capacity;
+    } checkpoints = {0};
+    struct {
+        unsigned char *items;
+        size_t count;
+        size_t capacity;
+    } deltas = {0};
+    struct {
+        LineIndexBlock *items;
+        size_t count;
+        size_t capacity;
+    } blocks = {0};
+    bool ok = indexpath != NULL && buf != NULL && grow_array((void **)&checkpoints.items, &checkpoints.capacity, 1, sizeof(uint64_t));
+    uint64_t offset = 0, line_count = 0;
+    if(ok) {
+        memcpy(indexpath, filepath, path_len);
+        memcpy(indexpath + path_len, LINE_INDEX_EXTENSION, sizeof(LINE_INDEX_EXTENSION));
+        checkpoints.items[checkpoints.count++] = 0;
+        LineIndex li;
+        if(line_index_open(&li, indexpath, &id)) {
+            if(li.header->interval == interval && line_index_matches(&li, fd)
+                    && grow_array((void **)&checkpoints.items, &checkpoints.capacity, (size_t)li.header->checkpoint_count, sizeof(uint64_t))) {
+                for(uint64_t i = 1; i < li.header->checkpoint_count; ++i) checkpoints.items[i] = line_index_checkpoint(&li, i);
+                checkpoints.count = (size_t)li.header->checkpoint_count;
+                offset = li.header->size;
+                line_count = li.header->line_count;
+            }
+            line_index_close(&li);
+        }
+    }
+
+    // Only what the file has now is indexed, a line written meanwhile is indexed the next time
+    while(ok && offset < id.size) {
+        size_t want = id.size - offset < STREAM_WINDOW_SIZE ? (size_t)(id.size - offset) : STREAM_WINDOW_SIZE;
+        long long n = btkfs_read_file_at(fd, buf, want, offset);
+        if(n <= 0) break;
+        for(const char *at = buf, *end = buf + n; (at = memchr(at, '\n', (size_t)(end - at))) != NULL; ) {
+            at += 1;
+            line_count += 1;
+            if(line_count % interval != 0) continue;
+            ok = ok && grow_array((void **)&checkpoints.items, &checkpoints.capacity, checkpoints.count + 1, sizeof(uint64_t));
+            if(ok) checkpoints.items[checkpoints.count++] = offset + (uint64_t)(at - buf);
+        }
+        offset += (uint64_t)n;
+    }
+    uint64_t tail_hash = 0;
+    ok = ok && line_index_tail_hash(fd, offset, &tail_hash);
+    btkfs_close_file(fd);
+
+    for(size_t i = 0; ok && i < checkpoints.count; ++i) {
+        ok = grow_array((void **)&deltas.items, &deltas.capacity, deltas.count + 10, sizeof(unsigned char));
+        if(!ok) break;
+        if(i % LINE_INDEX_BLOCK == 0) {
+            ok = grow_array((void **)&blocks.items, &blocks.capacity, blocks.count + 1, sizeof(LineIndexBlock));
+            if(ok) blocks.items[blocks.count++] = (LineIndexBlock){ .offset = checkpoints.items[i], .deltas = deltas.count };
+        } else {
+            deltas.count += varint_encode(checkpoints.items[i] - checkpoints.items[i - 1], deltas.items + deltas.count);
+        }
+    }
+    LineIndexHeader header = {
+        .magic = LINE_INDEX_MAGIC,
+        .interval = interval,
+        .device = id.device,
+        .inode = id.inode,
+        .size = offset,
+        .line_count = line_count,
+        .checkpoint_count = checkpoints.count,
+        .deltas_size = deltas.count,
+        .tail_hash = tail_hash,
+    };
+    int result = ok ? NG_OK : NG_ERROR_UNKNOWN;
+    FILE *fp = ok ? fopen(indexpath, "wb") : NULL;
+    if(ok && fp == NULL) result = NG_ERROR_COULDNT_OPEN;
+    if(fp != NULL) {
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(blocks.items, sizeof(LineIndexBlock), blocks.count, fp) == blocks.count
+            && fwrite(deltas.items, sizeof(unsigned char), deltas.count, fp) == deltas.count;
+        if(fclose(fp) != 0) ok = false;
+        if(!ok) result = NG_ERROR_UNKNOWN;
+    }
+    free(indexpath);
+    free(buf);
+    free(checkpoints.items);
+    free(deltas.items);
+    free(blocks.items);
+    return result;
+}
+
+ng_follower_t *ng_follower_new(const char *filepath)
+{
+    if(filepath == NULL) return NULL;
+    ng_follower_t *f = malloc(sizeof(ng_follower_t));
+    size_t path_len = strlen(filepath);
+    char *path = malloc(path_len + 1);
+    if(f == NULL || path == NULL) {
+        free(f);
+        free(path);
+        return NULL;
+    }
+    memcpy(path, filepath, path_len + 1);
+    *f = (ng_follower_t){ .path = path, .fd = -1 };
+    return f;
+}
+
+void ng_follower_free(ng_follower_t *follower)
+{
+    if(follower == NULL) return;
+    if(follower->fd >= 0) btkfs_close_file(follower->fd);
+    free(follower->path);
+    free(follower);
+}
+
+int ng_search_follower(ng_searcher_t *searcher, ng_follower_t *follower)
+{
+    if(searcher == NULL || follower == NULL) return NG_ERROR_INVALID_ARGUMENTS;
+    SearchContext *sc = searcher;
+    // The appended bytes are searched as a stream, these need more than the lines they're in
+    if(sc->pattern->bytes_mode || sc->invert_match || sc->before_context > 0 || sc->after_context > 0) {
+        return NG_ERROR_INVALID_ARGUMENTS;
+    }
+    sc->stopped = false;
+    search_in_follower(sc, follower);
+    return sc->stopped ? NG_ERROR_STOPPED : NG_OK;
+}
+
+uint64_t ng_searcher_match_count(const ng_searcher_t *searcher)
+{
+    return searcher ? searcher->find_count : 0;
+}
+
+ng_stats_t ng_searcher_stats(const ng_searcher_t *searcher)
+{
+    ng_stats_t stats = {0};
+    return searcher ? searcher->stats : stats;
+}
+
+const char *ng_explain(int error_code)
+{
+    switch(error_code) {
+        case NG_OK: return "Success";
+        case NG_ERROR_INVALID_ARGUMENTS: return "Invalid arguments";
+        case NG_ERROR_INVALID_PATTERN: return "Invalid pattern";
+        case NG_ERROR_COULDNT_OPEN: return "Couldn't open the file or directory";
+        case NG_ERROR_STOPPED: return "The search is stopped by the callback";
+        default: return "Unknown error";
+    }
+}
@@ -4,19 +4,23 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <stdarg.h>
 
-#define BTK_STRUTIL_IMPLEMENTATION
 #include "btk_strutil.h"
-
-#define BTK_ARENA_IMPLEMENTATION
 #include "btk_arena.h"
-
+#include "btk_thread.h"
 #include "btk_fsutil.h"
 
+#include "notgrep.h"
+
 #ifdef _WIN32
-#include "windows_dirent.h"
+#include <io.h>
+#include <fcntl.h>
 #else
-#include "dirent.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 #endif
 
 ///////////////////////////////////////////
@@ -41,278 +45,1162 @@ void usage(const char *program)
     fprintf(stderr, "## Positional Argument\n");
     fprintf(stderr, "   <PATTERN> Pattern to be searched\n");
     fprintf(stderr, "   <DIR?> A directory which files will be searched. This could be empty which means, %s will look in current dir\n", program);
+    fprintf(stderr, "          It's '-' or empty with a pipe for searching the standard input i.e. `journalctl | %s ERR`\n", program);
+    fprintf(stderr, "## Options\n");
+    fprintf(stderr, "   -j, --threads <N>          Number of threads used to scan a single huge file or the files of --files-from (default: number of CPUs)\n");
+    fprintf(stderr, "   --chunk-threshold <BYTES>  Files at least this big are scanned in chunks by multiple threads (default: 64 MiB)\n");
+    fprintf(stderr, "   --prefetch <N>             Read the next N files into the page cache while searching the current one (default: 0)\n");
+    fprintf(stderr, "   --drop-cache-threshold <BYTES> Drop files at least this big from the page cache after searching them,\n");
+    fprintf(stderr, "                              0 keeps everything (default: 256 MiB)\n");
+    fprintf(stderr, "   --stats                    Print the number of searched files and the prefetch hit rate to stderr\n");
+    fprintf(stderr, "   --cache <FILE>             Remember the matches of every file in FILE and don't read the unchanged files again\n");
+    fprintf(stderr, "   --cache-size <BYTES>       Size of the --cache file, the least recently used files are dropped (default: 64 MiB)\n");
+    fprintf(stderr, "   --bloom <FILE>             Skip the files that surely have no match by their Bloom filters in FILE\n");
+    fprintf(stderr, "   --bloom-build <FILE>       Write the Bloom filters of the files of <DIR?> to FILE instead of searching\n");
+    fprintf(stderr, "   --bloom-fp <RATE>          False positive rate of the filters made by --bloom-build (default: 0.01)\n");
+    fprintf(stderr, "   --suffix-array-build <FILE> Write a suffix array index of the files of <DIR?> to FILE instead of searching\n");
+    fprintf(stderr, "   --suffix-array <FILE>      Search the suffix array index in FILE instead of the files\n");
+    fprintf(stderr, "   --lines <A:B>              Only print the matches from row A up to but not including row B, A: and :B are open\n");
+    fprintf(stderr, "   --lines-index-build <FILE> Write the .nglines sidecar of FILE that --lines jumps to its rows with\n");
+    fprintf(stderr, "   --lines-interval <N>       Rows between the offsets kept by --lines-index-build (default: 1024)\n");
+    fprintf(stderr, "   --follow                   Keep searching what's appended to the file, like `tail -F`\n");
+    fprintf(stderr, "   -w, --word-regexp          Only match whole words, the bytes around a match are not letters, digits or '_'\n");
+    fprintf(stderr, "   -x, --line-regexp          Only match whole lines\n");
+    fprintf(stderr, "   -v, --invert-match         Print the lines without a match instead\n");
+    fprintf(stderr, "   --glob                     The pattern is a glob inside a line: ?, *, [a-z], [!a-z] and \\ to escape\n");
+    fprintf(stderr, "   --jit                      Compile the --glob to machine code (x86-64 only)\n");
+    fprintf(stderr, "   --fuzzy <K>                Also match text that's at most K inserted, deleted or replaced bytes away from the pattern\n");
+    fprintf(stderr, "   -A, --after-context <N>    Print N lines after each match\n");
+    fprintf(stderr, "   -B, --before-context <N>   Print N lines before each match\n");
+    fprintf(stderr, "   -C, --context <N>          Print N lines before and after each match\n");
+    fprintf(stderr, "   --json                     Print one JSON object per match (JSON Lines)\n");
+    fprintf(stderr, "   --binary-out               Print length prefixed binary records, see BinaryRecordType in the source\n");
+    fprintf(stderr, "   --files-from <FILE>        Search the files listed in FILE (one per line) instead of a directory, '-' is stdin\n");
+    fprintf(stderr, "   -0, --null                 The paths of --files-from are separated by NUL i.e. `git ls-files -z`\n");
+    fprintf(stderr, "   --hex, --bytes             The pattern is hex bytes with '?' as a wildcard nibble i.e. \"DE ?? BE EF\".\n");
+    fprintf(stderr, "                              The results are reported as byte offsets\n");
+}
+
+void args_error(const char *message)
+{
+    fprintf(stderr, "ERROR: %s\n", message);
+    usage("grepper");
+    exit(EXIT_FAILURE);
 }
 
 btk_stringview_t shift_args(Args *args, const char *on_error_message)
 {
     assert(args && "Invalid args pointer");
     assert(args && "Invalid on_error_message pointer");
-    if(args->count == 0) {
-        fprintf(stderr, "ERROR: %s\n", on_error_message);
-        usage("grepper");
-        exit(EXIT_FAILURE);
-    }
+    if(args->count == 0) args_error(on_error_message);
     const char *result = args->items[0];
     args->items += 1;
     args->count -= 1;
     return btk_sv_from_cstr(result);
 }
 
-int find_with_glob(btk_stringview_t pattern, btk_stringview_t text, size_t encounter_index)
-{
-    size_t j = 0;
-    size_t start_index = 0;
-    for(size_t i = 0; i < text.count; ++i) {
-        switch(pattern.data[j]) {
-            case '?':
-                {
-                    if(j == 0) start_index = i;
-                    j += 1;
-                } break;
-            case '*':
-                {
-
-                } break;
-            case '[':
-                {
-                } break;
-            case '(':
-                {
-                } break;
-            default:
-                {
-                    if(j == 0) start_index = i;
-                    j = pattern.data[j] == text.data[i] ? j + 1 : 0;
-                } break;
-        }
-        if(j == pattern.count) {
-            if(encounter_index == 0) {
-                return start_index;
-            }
-            encounter_index -= 1;
-        }
+uint64_t parse_number_arg(btk_stringview_t arg, const char *on_error_message)
+{
+    char *end = NULL;
+    unsigned long long result = strtoull(arg.data, &end, 10);
+    if(arg.count == 0 || end != arg.data + arg.count) args_error(on_error_message);
+    return result;
+}
+
+double parse_rate_arg(btk_stringview_t arg, const char *on_error_message)
+{
+    char *end = NULL;
+    double result = strtod(arg.data, &end);
+    if(arg.count == 0 || end != arg.data + arg.count || !(result > 0.0 && result < 1.0)) args_error(on_error_message);
+    return result;
+}
+
+// The rows are counted from 0 like the printed ones, "A:B" is from A up to but not including B. "A:" goes to the end
+// of the file, ":B" is from the start and "A" is only that row
+void parse_lines_arg(btk_stringview_t arg, uint64_t *first_row, uint64_t *row_count)
+{
+    const char *message = "Invalid range of rows, it should be A:B with A less than B";
+    const char *colon = memchr(arg.data, ':', arg.count);
+    if(colon == NULL) {
+        *first_row = parse_number_arg(arg, message);
+        *row_count = 1;
+        return;
     }
-    return -1;
+    btk_stringview_t first = btk_sv_from_parts(arg.data, (size_t)(colon - arg.data));
+    btk_stringview_t last = btk_sv_from_parts(colon + 1, arg.count - first.count - 1);
+    *first_row = first.count > 0 ? parse_number_arg(first, message) : 0;
+    *row_count = 0;
+    if(last.count > 0) {
+        uint64_t end_row = parse_number_arg(last, message);
+        if(end_row <= *first_row) args_error(message);
+        *row_count = end_row - *first_row;
+    }
+}
+
+// ng_read_fn of a FILE*. It reads whatever is available right now instead of waiting for the whole buffer like
+// fread, so what a slow producer on the other side of a pipe already wrote is searched while it's still running
+size_t read_some(void *user, char *buf, size_t bufsz)
+{
+    FILE *fp = user;
+#ifdef _WIN32
+    int n = _read(_fileno(fp), buf, (unsigned int)bufsz);
+#else
+    ssize_t n;
+    do {
+        n = read(fileno(fp), buf, bufsz);
+    } while(n < 0 && errno == EINTR);
+#endif
+    return n > 0 ? (size_t)n : 0;
+}
+
+bool is_terminal(FILE *fp)
+{
+#ifdef _WIN32
+    return _isatty(_fileno(fp)) != 0;
+#else
+    return isatty(fileno(fp)) != 0;
+#endif
+}
+
+// Only a pipe or a redirected file is searched when no path is given, not i.e. /dev/null of a cron job
+bool stdin_has_data(void)
+{
+#ifdef _WIN32
+    DWORD type = GetFileType(GetStdHandle(STD_INPUT_HANDLE));
+    return type == FILE_TYPE_PIPE || type == FILE_TYPE_DISK;
+#else
+    struct stat st;
+    if(fstat(fileno(stdin), &st) != 0) return false;
+    return S_ISFIFO(st.st_mode) || S_ISREG(st.st_mode) || S_ISSOCK(st.st_mode);
+#endif
 }
 
 ///////////////////////////////////////////
 ///
-/// Grep Logics
+/// Output
 ///
 
-typedef struct SearchResult {
-    btk_stringview_t filepath;
-    int row;
-    int col;
-    btk_stringview_t preview;
-} SearchResult;
-
-// TODO(bagasjs): We need another way of storing result since it would be so slow if we have to copy the data when appending new result
-typedef struct SearchContext {
-    btk_stringview_t pattern;
-    btk_arena_t in_life;
-    btk_arena_t in_file;
-    btk_arena_t in_dir;
-    uint32_t find_count;
-
-    char *readbuf;
-    uint32_t readbufsz;
-    struct {
-        SearchResult *items;
-        size_t count;
-        size_t capacity;
-    } results;
-} SearchContext;
-
-void sc_init(SearchContext *sc, btk_stringview_t pattern)
-{
-    assert(sc && "Invalid sc pointer");
-    sc->in_file = (btk_arena_t){0};
-    sc->in_dir = (btk_arena_t){0};
-    sc->in_life = (btk_arena_t){0};
-    sc->results.count = 0;
-    sc->results.capacity = 0;
-    sc->pattern = pattern;
-    sc->find_count = 0;
-}
-
-void sc_destroy(SearchContext *sc)
-{
-    assert(sc && "Invalid sc pointer");
-    btk_arena_free(&sc->in_life);
-    btk_arena_free(&sc->in_dir);
-    btk_arena_free(&sc->in_file);
-}
-
-void sc_append(SearchContext *sc, SearchResult res)
-{
-    assert(sc && "Invalid sc pointer");
-    if(sc->results.count >= sc->results.capacity) {
-        sc->results.capacity = sc->results.capacity == 0 ? 1024 : sc->results.capacity*2;
-        SearchResult *new_items = btk_arena_alloc(&sc->in_life, sc->results.capacity*sizeof(SearchResult));
-        memcpy(new_items, sc->results.items, sc->results.count*sizeof(SearchResult));
-        sc->results.items = new_items;
-    }
-    sc->results.items[sc->results.count++] = res;
-}
-
-// TODO(bagasjs): Regex searching
-void search_in_line(SearchContext *sc, btk_stringview_t line, btk_stringview_t filepath, size_t row)
-{
-    assert(sc && "Invalid sc pointer");
-    btk_stringview_t pattern = sc->pattern;
-    size_t found = 0;
-    for(size_t i = 0; i < line.count; ++i) {
-        if(line.data[i] == pattern.data[found]) {
-            ++found;
-            if(pattern.count == found) {
-                sc->find_count += 1;
-                sc_append(sc, (SearchResult){
-                    .row = row,
-                    .col = 0, // TODO(bagasjs): Get the column number
-                    .filepath = filepath,
-                    .preview = (btk_stringview_t){ 
-                        .count = line.count, .data = btk_arena_bufdup(&sc->in_life, line.data, line.count) 
-                    },
-                });
-            }
+#define WRITER_CAPACITY (64*1024)
+
+// Batches the small writes of the results into one fwrite
+typedef struct Writer {
+    FILE *fp;
+    char *buf;
+    size_t count;
+    size_t capacity;
+    // When several writers share `fp` the lock is taken on the first write and kept until writer_end, so
+    // the output in between is never mixed with the others
+    btk_mutex_t *lock;
+    bool locked;
+} Writer;
+
+void writer_init(Writer *w, FILE *fp, char *buf, size_t capacity)
+{
+    w->fp = fp;
+    w->buf = buf;
+    w->count = 0;
+    w->capacity = capacity;
+    w->lock = NULL;
+    w->locked = false;
+}
+
+void writer_acquire(Writer *w)
+{
+    if(w->lock == NULL || w->locked) return;
+    btk_mutex_lock(w->lock);
+    w->locked = true;
+}
+
+void writer_flush(Writer *w)
+{
+    if(w->count > 0) {
+        writer_acquire(w);
+        fwrite(w->buf, 1, w->count, w->fp);
+    }
+    w->count = 0;
+}
+
+// Flush and let the other writers of the same stream write
+void writer_end(Writer *w)
+{
+    writer_flush(w);
+    if(w->locked) btk_mutex_unlock(w->lock);
+    w->locked = false;
+}
+
+void writer_write(Writer *w, const char *data, size_t count)
+{
+    if(w->count + count > w->capacity) {
+        writer_flush(w);
+        if(count > w->capacity) {
+            writer_acquire(w);
+            fwrite(data, 1, count, w->fp);
+            return;
+        }
+    }
+    memcpy(w->buf + w->count, data, count);
+    w->count += count;
+}
+
+#define writer_write_literal(w, literal) writer_write((w), (literal), sizeof(literal) - 1)
+
+void writer_printf(Writer *w, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->count, w->capacity - w->count, fmt, args);
+    va_end(args);
+    if(n < 0) return;
+    if((size_t)n >= w->capacity - w->count) {
+        writer_flush(w);
+        va_start(args, fmt);
+        if((size_t)n < w->capacity) {
+            n = vsnprintf(w->buf, w->capacity, fmt, args);
         } else {
-            if(found > 0) found = 0;
+            writer_acquire(w);
+            vfprintf(w->fp, fmt, args);
+            n = 0;
+        }
+        va_end(args);
+    }
+    w->count += (size_t)n;
+}
+
+typedef enum OutputFormat {
+    OUTPUT_TEXT = 0,
+    OUTPUT_JSON,   // JSON Lines, one object per match
+    OUTPUT_BINARY, // Length prefixed records, see BinaryRecordType
+} OutputFormat;
+
+// The --binary-out stream starts with BINARY_OUT_MAGIC followed by records of `u32 size, u8 type, payload`
+// where the size counts the type and the payload. All numbers are little endian. Paths are sent once as a
+// PATH record and the other records refer to them by their id. The ids are unique but not always consecutive
+#define BINARY_OUT_MAGIC "NGB1"
+typedef enum BinaryRecordType {
+    BINARY_RECORD_PATH = 1,    // u32 path_id, path bytes
+    BINARY_RECORD_MATCH = 2,   // u32 path_id, u64 row, u64 col, u64 offset, u64 line_offset, u32 match_len, u64 preview_offset, preview bytes
+    BINARY_RECORD_CONTEXT = 3, // u32 path_id, u64 row, u64 offset, line bytes
+    BINARY_RECORD_LINES = 4,   // u32 path_id, u64 row, u64 offset, bytes of the lines with their newlines
+} BinaryRecordType;
+
+typedef struct PathEntry {
+    btk_stringview_t path;
+    uint32_t id;
+} PathEntry;
+
+typedef struct PathInterner {
+    PathEntry *items;
+    size_t capacity;
+    uint32_t count;
+    // Results of the same file come one after another, so most of the lookups are the previous path
+    btk_stringview_t last_path;
+    uint32_t last_id;
+    // Printers of different threads write to the same stream, so each one hands out the ids
+    // id_base, id_base + id_stride, ... to keep them unique. A zero stride is the same as 1
+    uint32_t id_base;
+    uint32_t id_stride;
+} PathInterner;
+
+typedef struct Printer {
+    Writer *writer;
+    OutputFormat format;
+    bool bytes_mode;
+    btk_arena_t *arena;
+    PathInterner paths;
+    // The last printed match when there're context lines
+    bool with_context;
+    // Every record is written right away when someone is watching the terminal
+    bool line_buffered;
+    btk_stringview_t last_path;
+    uint64_t last_row;
+} Printer;
+
+uint64_t hash_bytes(const char *data, size_t count)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < count; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint32_t path_intern(PathInterner *pi, btk_arena_t *a, btk_stringview_t path, bool *is_new)
+{
+    *is_new = false;
+    if(btk_sv_eq(pi->last_path, path)) return pi->last_id;
+    if((size_t)pi->count*2 >= pi->capacity) {
+        size_t new_capacity = pi->capacity == 0 ? 256 : pi->capacity*2;
+        PathEntry *new_items = btk_arena_alloc(a, new_capacity*sizeof(PathEntry));
+        memset(new_items, 0, new_capacity*sizeof(PathEntry));
+        for(size_t i = 0; i < pi->capacity; ++i) {
+            if(pi->items[i].path.data == NULL) continue;
+            size_t at = hash_bytes(pi->items[i].path.data, pi->items[i].path.count) & (new_capacity - 1);
+            while(new_items[at].path.data != NULL) at = (at + 1) & (new_capacity - 1);
+            new_items[at] = pi->items[i];
         }
+        pi->items = new_items;
+        pi->capacity = new_capacity;
+    }
+    size_t at = hash_bytes(path.data, path.count) & (pi->capacity - 1);
+    while(pi->items[at].path.data != NULL && !btk_sv_eq(pi->items[at].path, path)) at = (at + 1) & (pi->capacity - 1);
+    if(pi->items[at].path.data == NULL) {
+        // The path could live in an arena that's reset after its directory is done
+        pi->items[at].path = (btk_stringview_t){ .count = path.count, .data = btk_arena_bufdup(a, path.data, path.count) };
+        pi->items[at].id = pi->id_base + pi->count*(pi->id_stride > 0 ? pi->id_stride : 1);
+        pi->count += 1;
+        *is_new = true;
     }
+    pi->last_path = pi->items[at].path;
+    pi->last_id = pi->items[at].id;
+    return pi->last_id;
 }
 
-// Search in file 1st version
-// Allocate a buffer that resizable then read line by line then search in that line.
-// This won't work if the file is something like Javascript Bundled source
-void search_in_file1(SearchContext *sc, btk_stringview_t filepath)
+void writer_put_u8(Writer *w, uint8_t value)
 {
-    assert(sc && "Invalid sc pointer");
+    writer_write(w, (const char *)&value, 1);
+}
 
-    const char *filepath_cstr = btk_arena_bufdup(&sc->in_file, filepath.data, filepath.count);
-    FILE *fp = fopen(filepath_cstr, "r");
-    assert(fp != NULL);
-    size_t fsz = 0;
-    fseek(fp, 0L, SEEK_END);
-    fsz = ftell(fp);
-    fseek(fp, 0L, SEEK_SET);
+void writer_put_u32(Writer *w, uint32_t value)
+{
+    char bytes[4];
+    for(int i = 0; i < 4; ++i) bytes[i] = (char)((value >> (8*i)) & 0xFF);
+    writer_write(w, bytes, sizeof(bytes));
+}
 
-    int ch;
-    uint32_t row = 0;
-    uint32_t cur = 0;
-    while((ch = fgetc(fp)) != EOF) {
-        if(cur == sc->readbufsz) {
-            btk_arena_reset(&sc->in_file);
-            return;
+void writer_put_u64(Writer *w, uint64_t value)
+{
+    char bytes[8];
+    for(int i = 0; i < 8; ++i) bytes[i] = (char)((value >> (8*i)) & 0xFF);
+    writer_write(w, bytes, sizeof(bytes));
+}
+
+// Write the content of a JSON string. Bytes that are not valid UTF-8 are written as \u00XX
+void writer_put_json_string(Writer *w, btk_stringview_t text)
+{
+    writer_write(w, "\"", 1);
+    const unsigned char *bytes = (const unsigned char *)text.data;
+    size_t plain = 0;
+    for(size_t i = 0; i < text.count;) {
+        unsigned char ch = bytes[i];
+        size_t seqlen = 0;
+        if(ch >= 0x20 && ch < 0x80 && ch != '"' && ch != '\\') seqlen = 1;
+        else if(ch >= 0xC2 && ch <= 0xDF) seqlen = 2;
+        else if(ch >= 0xE0 && ch <= 0xEF) seqlen = 3;
+        else if(ch >= 0xF0 && ch <= 0xF4) seqlen = 4;
+        bool valid = seqlen > 0 && i + seqlen <= text.count;
+        for(size_t j = 1; valid && j < seqlen; ++j) valid = (bytes[i + j] & 0xC0) == 0x80;
+        if(valid) {
+            i += seqlen;
+            continue;
         }
-        if(ch == '\n') {
-            sc->readbuf[cur] = 0;
-            search_in_line(sc, btk_sv_from_cstr(sc->readbuf), filepath, row);
-            row += 1;
-            cur = 0;
-        } else {
-            // TODO (bagasjs): Handle if the line is bigger than the buf
-            sc->readbuf[cur] = ch;
-            cur++;
+        writer_write(w, text.data + plain, i - plain);
+        switch(ch) {
+            case '"': writer_write(w, "\\\"", 2); break;
+            case '\\': writer_write(w, "\\\\", 2); break;
+            case '\n': writer_write(w, "\\n", 2); break;
+            case '\r': writer_write(w, "\\r", 2); break;
+            case '\t': writer_write(w, "\\t", 2); break;
+            default: writer_printf(w, "\\u%04x", ch); break;
         }
+        i += 1;
+        plain = i;
     }
+    writer_write(w, text.data + plain, text.count - plain);
+    writer_write(w, "\"", 1);
+}
+
+///////////////////////////////////////////
+///
+/// Printing results
+///
 
-    btk_arena_reset(&sc->in_file);
+void show_result(Writer *w, const ng_match_t *m)
+{
+    writer_write(w, m->path, m->path_len);
+    writer_printf(w, ":%"PRIu64":%"PRIu64":", m->row, m->col);
+    writer_write(w, m->preview, m->preview_len);
+    writer_write(w, "\n", 1);
 }
 
-// Search in file 2nd version
-// Allocate an exact sized buffer then read the file data with that buffer size. But we need somehow a way
-// to continue the check if we reached end of the file but we still don't checked all the way to the pattern
-// Maybe it would be cool if we can search for byte files like maybe an input for a hex bytes like grep 0xFFFFFF
-void search_in_file2(SearchContext *sc, btk_stringview_t filepath)
+void show_byte_result(Writer *w, const ng_match_t *m)
 {
-    assert(sc && "Invalid sc pointer");
-    assert(0 && "Unimplemented");
+    writer_write(w, m->path, m->path_len);
+    writer_printf(w, ":0x%08"PRIx64":", m->offset);
+    for(size_t i = 0; i < m->preview_len; ++i) {
+        writer_printf(w, i == 0 ? "%02X" : " %02X", (unsigned char)m->preview[i]);
+    }
+    writer_write(w, "\n", 1);
 }
 
-const char *arena_path_join(btk_arena_t *a, const char *path_a, const char *path_b)
+// Write a binary record header, sending the path first if it's the first time it's seen
+void printer_begin_record(Printer *p, BinaryRecordType type, btk_stringview_t filepath, size_t payload_size)
 {
-    int res = btkfs_path_join(NULL, 0, path_a, path_b);
-    assert(res > 0 && "Failed to join path");
-    char *joined_path = btk_arena_alloc(a, sizeof(char)*res);
-    assert(btkfs_path_join(joined_path, res, path_a, path_b) == 0);
-    return joined_path;
+    bool is_new;
+    uint32_t path_id = path_intern(&p->paths, p->arena, filepath, &is_new);
+    if(is_new) {
+        writer_put_u32(p->writer, (uint32_t)(1 + 4 + filepath.count));
+        writer_put_u8(p->writer, BINARY_RECORD_PATH);
+        writer_put_u32(p->writer, path_id);
+        writer_write(p->writer, filepath.data, filepath.count);
+    }
+    writer_put_u32(p->writer, (uint32_t)(1 + 4 + payload_size));
+    writer_put_u8(p->writer, (uint8_t)type);
+    writer_put_u32(p->writer, path_id);
 }
 
-// TODO(bagasjs): Evaluating .gitignore content if it exists in the directory
-void inner_search_in_dir(SearchContext *sc, btk_stringview_t dirpath, int depth)
+void print_result(Printer *p, const ng_match_t *m)
 {
-    assert(sc && "Invalid sc pointer");
-    struct dirent *ep = NULL;
+    Writer *w = p->writer;
+    btk_stringview_t filepath = btk_sv_from_parts(m->path, m->path_len);
+    btk_stringview_t preview = btk_sv_from_parts(m->preview, m->preview_len);
+    switch(p->format) {
+        case OUTPUT_TEXT: {
+            if(p->bytes_mode) show_byte_result(w, m);
+            else show_result(w, m);
+        } break;
+        case OUTPUT_JSON: {
+            writer_write_literal(w, "{\"type\":\"match\",\"path\":");
+            writer_put_json_string(w, filepath);
+            if(p->bytes_mode) {
+                writer_printf(w, ",\"offset\":%"PRIu64",\"len\":%zu,\"bytes\":\"", m->offset, m->len);
+                for(size_t i = 0; i < preview.count; ++i) writer_printf(w, "%02X", (unsigned char)preview.data[i]);
+                writer_write(w, "\"}\n", 3);
+                break;
+            }
+            writer_printf(w, ",\"row\":%"PRIu64",\"col\":%"PRIu64",\"offset\":%"PRIu64",\"line_offset\":%"PRIu64
+                    ",\"submatches\":[{\"start\":%"PRIu64",\"end\":%"PRIu64"}],\"preview_offset\":%"PRIu64",\"preview\":",
+                    m->row, m->col, m->offset, m->line_offset, m->offset - m->line_offset,
+                    m->offset - m->line_offset + m->len, m->preview_offset);
+            writer_put_json_string(w, preview);
+            writer_write(w, "}\n", 2);
+        } break;
+        case OUTPUT_BINARY: {
+            printer_begin_record(p, BINARY_RECORD_MATCH, filepath, 8*4 + 4 + 8 + preview.count);
+            writer_put_u64(w, m->row);
+            writer_put_u64(w, m->col);
+            writer_put_u64(w, m->offset);
+            writer_put_u64(w, m->line_offset);
+            writer_put_u32(w, (uint32_t)m->len);
+            writer_put_u64(w, m->preview_offset);
+            writer_write(w, preview.data, preview.count);
+        } break;
+    }
+}
 
-    DIR *dp = opendir(dirpath.data);
-    while((ep=readdir(dp)) != NULL) {
-        bool is_cwd_or_parent = strncmp(ep->d_name, ".", sizeof(ep->d_name)) == 0 
-            || strncmp(ep->d_name, "..", sizeof(ep->d_name)) == 0;
-        if(is_cwd_or_parent) continue;
-        const char *target = arena_path_join(&sc->in_dir, dirpath.data, ep->d_name);
-        if(btkfs_isdir(target)) {
-            inner_search_in_dir(sc, btk_sv_from_cstr(target), depth + 1);
-        } else {
-            search_in_file1(sc, btk_sv_from_cstr(target));
+void print_context_line(Printer *p, const ng_match_t *m)
+{
+    Writer *w = p->writer;
+    btk_stringview_t filepath = btk_sv_from_parts(m->path, m->path_len);
+    btk_stringview_t line = btk_sv_from_parts(m->preview, m->preview_len);
+    switch(p->format) {
+        case OUTPUT_TEXT: {
+            writer_write(w, filepath.data, filepath.count);
+            writer_printf(w, "-%"PRIu64"-", m->row);
+            writer_write(w, line.data, line.count);
+            writer_write(w, "\n", 1);
+        } break;
+        case OUTPUT_JSON: {
+            writer_write_literal(w, "{\"type\":\"context\",\"path\":");
+            writer_put_json_string(w, filepath);
+            writer_printf(w, ",\"row\":%"PRIu64",\"offset\":%"PRIu64",\"line\":", m->row, m->offset);
+            writer_put_json_string(w, line);
+            writer_write(w, "}\n", 2);
+        } break;
+        case OUTPUT_BINARY: {
+            printer_begin_record(p, BINARY_RECORD_CONTEXT, filepath, 8*2 + line.count);
+            writer_put_u64(w, m->row);
+            writer_put_u64(w, m->offset);
+            writer_write(w, line.data, line.count);
+        } break;
+    }
+}
+
+// The lines without a match of -v. The text format needs the prefix of each line, the others take the whole range
+void print_lines(Printer *p, const ng_match_t *m)
+{
+    Writer *w = p->writer;
+    btk_stringview_t filepath = btk_sv_from_parts(m->path, m->path_len);
+    btk_stringview_t lines = btk_sv_from_parts(m->preview, m->preview_len);
+    switch(p->format) {
+        case OUTPUT_TEXT: {
+            uint64_t row = m->row;
+            while(lines.count > 0) {
+                size_t newline = btk_sv_find_byte(lines, '\n');
+                size_t line_len = newline == BTK_SV_NPOS ? lines.count : newline;
+                writer_write(w, filepath.data, filepath.count);
+                writer_printf(w, ":%"PRIu64":", row++);
+                writer_write(w, lines.data, line_len);
+                writer_write(w, "\n", 1);
+                lines = btk_sv_slice(lines, newline == BTK_SV_NPOS ? lines.count : newline + 1, lines.count);
+            }
+        } break;
+        case OUTPUT_JSON: {
+            writer_write_literal(w, "{\"type\":\"lines\",\"path\":");
+            writer_put_json_string(w, filepath);
+            writer_printf(w, ",\"row\":%"PRIu64",\"offset\":%"PRIu64",\"text\":", m->row, m->offset);
+            writer_put_json_string(w, lines);
+            writer_write(w, "}\n", 2);
+        } break;
+        case OUTPUT_BINARY: {
+            printer_begin_record(p, BINARY_RECORD_LINES, filepath, 8*2 + lines.count);
+            writer_put_u64(w, m->row);
+            writer_put_u64(w, m->offset);
+            writer_write(w, lines.data, lines.count);
+        } break;
+    }
+}
+
+// Separates the groups of context lines
+void print_context_break(Printer *p)
+{
+    if(p->format == OUTPUT_TEXT) writer_write(p->writer, "--\n", 3);
+}
+
+// ng_match_fn of the command line. In the text format with context lines a line with several matches is printed
+// once with the column of its first match
+int print_record(void *user, const ng_match_t *m)
+{
+    Printer *p = user;
+    switch(m->kind) {
+        case NG_RECORD_MATCH: {
+            btk_stringview_t filepath = btk_sv_from_parts(m->path, m->path_len);
+            if(p->with_context && p->format == OUTPUT_TEXT && m->row == p->last_row && btk_sv_eq(filepath, p->last_path)) break;
+            print_result(p, m);
+            if(p->with_context) {
+                // The path may be gone after the callback, so only a copy of it is remembered
+                if(!btk_sv_eq(filepath, p->last_path)) {
+                    p->last_path = (btk_stringview_t){ .count = filepath.count, .data = btk_arena_bufdup(p->arena, filepath.data, filepath.count) };
+                }
+                p->last_row = m->row;
+            }
+        } break;
+        case NG_RECORD_CONTEXT: print_context_line(p, m); break;
+        case NG_RECORD_CONTEXT_BREAK: print_context_break(p); break;
+        case NG_RECORD_LINES: print_lines(p, m); break;
+    }
+    if(p->line_buffered) writer_flush(p->writer);
+    return 0;
+}
+
+void add_stats(ng_stats_t *total, ng_stats_t stats)
+{
+    total->files += stats.files;
+    total->bytes += stats.bytes;
+    total->prefetched += stats.prefetched;
+    total->prefetch_hits += stats.prefetch_hits;
+    total->dropped += stats.dropped;
+    total->cache_hits += stats.cache_hits;
+    total->bloom_skipped += stats.bloom_skipped;
+}
+
+void print_stats(ng_stats_t stats)
+{
+    fprintf(stderr, "%"PRIu64" files searched (%"PRIu64" bytes)\n", stats.files, stats.bytes);
+    fprintf(stderr, "%"PRIu64" files prefetched, %"PRIu64" of them were in the page cache when searched", stats.prefetched, stats.prefetch_hits);
+    if(stats.prefetched > 0) fprintf(stderr, " (%.1f%% hit rate)", 100.0*(double)stats.prefetch_hits/(double)stats.prefetched);
+    fprintf(stderr, "\n%"PRIu64" files dropped from the page cache\n", stats.dropped);
+    fprintf(stderr, "%"PRIu64" files served from the result cache\n", stats.cache_hits);
+    fprintf(stderr, "%"PRIu64" files skipped by their Bloom filters\n", stats.bloom_skipped);
+}
+
+///////////////////////////////////////////
+///
+/// Searching a list of files (--files-from)
+///
+
+#define FILE_LIST_READ_SIZE (64*1024)
+#define FILE_LIST_BATCH_PATHS 256
+#define FILE_LIST_QUEUE_CAPACITY 64
+
+// The paths are stored one after another and each one ends with a NUL
+typedef struct PathBatch {
+    char *data;
+    size_t count;
+    size_t capacity;
+    size_t path_count;
+    size_t path_start; // Where the path that's still being read starts
+} PathBatch;
+
+PathBatch *path_batch_new(void)
+{
+    PathBatch *batch = malloc(sizeof(PathBatch));
+    assert(batch && "Failed to allocate memory");
+    *batch = (PathBatch){0};
+    batch->capacity = 16*1024;
+    batch->data = malloc(batch->capacity);
+    assert(batch->data && "Failed to allocate memory");
+    return batch;
+}
+
+void path_batch_free(PathBatch *batch)
+{
+    free(batch->data);
+    free(batch);
+}
+
+void path_batch_append(PathBatch *batch, const char *data, size_t count)
+{
+    if(batch->count + count + 1 > batch->capacity) {
+        while(batch->count + count + 1 > batch->capacity) batch->capacity *= 2;
+        batch->data = realloc(batch->data, batch->capacity);
+        assert(batch->data && "Failed to allocate memory");
+    }
+    memcpy(batch->data + batch->count, data, count);
+    batch->count += count;
+}
+
+// Terminate the path that's being read. Empty lines are skipped
+void path_batch_end_path(PathBatch *batch)
+{
+    if(batch->count > batch->path_start && batch->data[batch->count - 1] == '\r') batch->count -= 1;
+    if(batch->count == batch->path_start) return;
+    batch->data[batch->count++] = 0;
+    batch->path_count += 1;
+    batch->path_start = batch->count;
+}
+
+// Bounded queue of batches from the reading thread to the searching threads
+typedef struct BatchQueue {
+    PathBatch *items[FILE_LIST_QUEUE_CAPACITY];
+    size_t head;
+    size_t tail;
+    bool closed;
+    btk_mutex_t mutex;
+    btk_cond_t not_empty;
+    btk_cond_t not_full;
+} BatchQueue;
+
+void batch_queue_push(BatchQueue *q, PathBatch *batch)
+{
+    btk_mutex_lock(&q->mutex);
+    while(q->head - q->tail == FILE_LIST_QUEUE_CAPACITY) btk_cond_wait(&q->not_full, &q->mutex);
+    q->items[q->head % FILE_LIST_QUEUE_CAPACITY] = batch;
+    q->head += 1;
+    btk_cond_signal(&q->not_empty);
+    btk_mutex_unlock(&q->mutex);
+}
+
+void batch_queue_close(BatchQueue *q)
+{
+    btk_mutex_lock(&q->mutex);
+    q->closed = true;
+    btk_cond_broadcast(&q->not_empty);
+    btk_mutex_unlock(&q->mutex);
+}
+
+// Returns NULL once the queue is closed and everything is taken
+PathBatch *batch_queue_pop(BatchQueue *q)
+{
+    btk_mutex_lock(&q->mutex);
+    while(q->head == q->tail && !q->closed) btk_cond_wait(&q->not_empty, &q->mutex);
+    PathBatch *batch = NULL;
+    if(q->head != q->tail) {
+        batch = q->items[q->tail % FILE_LIST_QUEUE_CAPACITY];
+        q->tail += 1;
+        btk_cond_signal(&q->not_full);
+    }
+    btk_mutex_unlock(&q->mutex);
+    return batch;
+}
+
+typedef struct FileWorker {
+    BatchQueue *queue;
+    const ng_pattern_t *pattern;
+    ng_search_options_t options;
+    Writer writer;
+    Printer printer;
+    btk_arena_t arena;
+    uint64_t match_count;
+    ng_stats_t stats;
+    btk_thread_t thread;
+} FileWorker;
+
+void file_worker_run(void *arg)
+{
+    FileWorker *fw = arg;
+    ng_searcher_t *searcher = ng_searcher_new(fw->pattern, &fw->options, print_record, &fw->printer);
+    assert(searcher && "Failed to create the searcher");
+    PathBatch *batch;
+    while((batch = batch_queue_pop(fw->queue)) != NULL) {
+        const char *path = batch->data;
+        // The next `prefetch_depth` paths of the batch are read by the OS while the current one is searched
+        const char *ahead = path + strlen(path) + 1;
+        size_t next_prefetch = 1;
+        for(size_t i = 0; i < batch->path_count; ++i) {
+            for(; next_prefetch < batch->path_count && next_prefetch <= i + (size_t)fw->options.prefetch_depth; ++next_prefetch) {
+                ng_prefetch_file(searcher, ahead);
+                ahead += strlen(ahead) + 1;
+            }
+            if(ng_search_file(searcher, path) == NG_ERROR_COULDNT_OPEN) {
+                fprintf(stderr, "WARNING: Could not open %s\n", path);
+            }
+            // The output of a file is written at once so it's not mixed with the other threads
+            writer_end(&fw->writer);
+            path += strlen(path) + 1;
+        }
+        path_batch_free(batch);
+    }
+    fw->match_count = ng_searcher_match_count(searcher);
+    fw->stats = ng_searcher_stats(searcher);
+    ng_searcher_free(searcher);
+}
+
+// Search the files listed in `listpath` ("-" is stdin) without walking any directory. This thread only reads
+// the list and hands it over in batches to `worker_count` searching threads, so the search starts before the
+// list is complete. Each worker has its own searcher and output buffer, only the flushes are serialized.
+// This function returns the number of matches, the stats of all of the workers are added into `stats`
+uint64_t search_files_from(const char *listpath, char delimiter, const ng_pattern_t *pattern,
+        ng_search_options_t options, const Printer *printer, int worker_count, ng_stats_t *stats)
+{
+    bool from_stdin = strcmp(listpath, "-") == 0;
+    FILE *fp = from_stdin ? stdin : fopen(listpath, "rb");
+    if(fp == NULL) {
+        fprintf(stderr, "ERROR: Could not open the file list %s\n", listpath);
+        exit(EXIT_FAILURE);
+    }
+    if(worker_count < 1) worker_count = 1;
+    // The files are already spread across the threads
+    options.thread_count = 1;
+
+    btk_mutex_t output_lock;
+    btk_mutex_init(&output_lock);
+    BatchQueue queue = {0};
+    btk_mutex_init(&queue.mutex);
+    btk_cond_init(&queue.not_empty);
+    btk_cond_init(&queue.not_full);
+
+    FileWorker *workers = calloc((size_t)worker_count, sizeof(FileWorker));
+    assert(workers && "Failed to allocate memory");
+    for(int i = 0; i < worker_count; ++i) {
+        FileWorker *fw = &workers[i];
+        fw->queue = &queue;
+        fw->pattern = pattern;
+        fw->options = options;
+        writer_init(&fw->writer, printer->writer->fp, btk_arena_alloc(&fw->arena, WRITER_CAPACITY), WRITER_CAPACITY);
+        fw->writer.lock = &output_lock;
+        fw->printer = (Printer){
+            .writer = &fw->writer,
+            .format = printer->format,
+            .bytes_mode = printer->bytes_mode,
+            .arena = &fw->arena,
+            .with_context = printer->with_context,
+            .line_buffered = printer->line_buffered,
+            .paths = { .id_base = (uint32_t)i, .id_stride = (uint32_t)worker_count },
+        };
+        if(btk_thread_create(&fw->thread, file_worker_run, fw) != 0) {
+            fprintf(stderr, "ERROR: Could not start the searching threads\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    char *buf = malloc(FILE_LIST_READ_SIZE);
+    assert(buf && "Failed to allocate memory");
+    PathBatch *batch = path_batch_new();
+    size_t n;
+    while((n = read_some(fp, buf, FILE_LIST_READ_SIZE)) > 0) {
+        btk_stringview_t block = btk_sv_from_parts(buf, n);
+        while(block.count > 0) {
+            size_t end = btk_sv_find_byte(block, delimiter);
+            path_batch_append(batch, block.data, end == BTK_SV_NPOS ? block.count : end);
+            if(end == BTK_SV_NPOS) break;
+            path_batch_end_path(batch);
+            block = btk_sv_slice(block, end + 1, block.count);
+            if(batch->path_count >= FILE_LIST_BATCH_PATHS) {
+                batch_queue_push(&queue, batch);
+                batch = path_batch_new();
+            }
+        }
+        // Don't keep the workers waiting for a full batch when the list is coming slowly
+        if(batch->path_count > 0) {
+            PathBatch *rest = path_batch_new();
+            path_batch_append(rest, batch->data + batch->path_start, batch->count - batch->path_start);
+            batch->count = batch->path_start;
+            batch_queue_push(&queue, batch);
+            batch = rest;
         }
     }
-    closedir(dp);
-    if(depth == 0) btk_arena_reset(&sc->in_dir);
+    // The last path doesn't always end with the delimiter
+    path_batch_end_path(batch);
+    if(batch->path_count > 0) batch_queue_push(&queue, batch);
+    else path_batch_free(batch);
+    batch_queue_close(&queue);
+    free(buf);
+    if(!from_stdin) fclose(fp);
+
+    uint64_t match_count = 0;
+    for(int i = 0; i < worker_count; ++i) {
+        btk_thread_join(&workers[i].thread);
+        match_count += workers[i].match_count;
+        add_stats(stats, workers[i].stats);
+        btk_arena_free(&workers[i].arena);
+    }
+    free(workers);
+    btk_cond_destroy(&queue.not_full);
+    btk_cond_destroy(&queue.not_empty);
+    btk_mutex_destroy(&queue.mutex);
+    btk_mutex_destroy(&output_lock);
+    return match_count;
+}
+
+#define DEFAULT_CACHE_SIZE (64ull*1024*1024)
+#define DEFAULT_BLOOM_FALSE_POSITIVE_RATE 0.01
+#define DEFAULT_LINES_INTERVAL 1024
+// The file is also checked this often with nothing from the watch, i.e. inotify doesn't see the writes of other
+// machines to a network filesystem. Without inotify it's how often the file is checked at all
+#define FOLLOW_RESCAN_INTERVAL_MS 1000
+#define FOLLOW_POLL_INTERVAL_MS 100
+
+// This function returns int which is the exit code
+int build_suffix_array_index(const char *outpath, const char *path)
+{
+    ng_suffix_array_builder_t *builder = ng_suffix_array_builder_new();
+    if(builder == NULL) {
+        fprintf(stderr, "ERROR: Couldn't allocate the suffix array builder\n");
+        return EXIT_FAILURE;
+    }
+    int res = btkfs_isdir(path) ? ng_suffix_array_add_dir(builder, path) : ng_suffix_array_add_file(builder, path);
+    if(res == NG_OK) res = ng_suffix_array_write(builder, outpath);
+    ng_suffix_array_builder_free(builder);
+    if(res != NG_OK) {
+        fprintf(stderr, "ERROR: Couldn't build the suffix array of %s into %s: %s\n", path, outpath, ng_explain(res));
+        return EXIT_FAILURE;
+    }
+    return 0;
 }
 
-void search_in_dir(SearchContext *sc, btk_stringview_t dirpath)
+// This function returns int which is the exit code
+int build_bloom_sidecar(const char *outpath, const char *path, double false_positive_rate)
 {
-    assert(sc && "Invalid sc pointer");
-    return inner_search_in_dir(sc, dirpath, 0);
+    ng_bloom_builder_t *builder = ng_bloom_builder_new(false_positive_rate);
+    if(builder == NULL) {
+        fprintf(stderr, "ERROR: Couldn't allocate the Bloom filter builder\n");
+        return EXIT_FAILURE;
+    }
+    int res = btkfs_isdir(path) ? ng_bloom_add_dir(builder, path) : ng_bloom_add_file(builder, path);
+    if(res == NG_OK) res = ng_bloom_write(builder, outpath);
+    ng_bloom_builder_free(builder);
+    if(res != NG_OK) {
+        fprintf(stderr, "ERROR: Couldn't build the Bloom filters of %s into %s: %s\n", path, outpath, ng_explain(res));
+        return EXIT_FAILURE;
+    }
+    return 0;
 }
 
-void show_result(SearchResult res)
+// The directory of the file is watched, so a rotated or recreated file is seen as well as the writes to it. The
+// matches are written out after every round of searching, no matter where the output goes
+// This function returns int which is the exit code, it only returns if the output is gone
+int follow_file(ng_searcher_t *searcher, const char *path, Writer *writer, btk_arena_t *arena)
 {
-    printf(BTK_SV_FMT":%u:%u:"BTK_SV_FMT"\n", BTK_SV_ARGV(res.filepath), res.row, res.col, BTK_SV_ARGV(res.preview));
+    ng_follower_t *follower = ng_follower_new(path);
+    if(follower == NULL) {
+        fprintf(stderr, "ERROR: Couldn't allocate the follower\n");
+        return EXIT_FAILURE;
+    }
+    const char *separator = strrchr(path, BTKFS_PATHSEP);
+    const char *dirpath = ".";
+    if(separator != NULL) {
+        size_t dir_len = separator == path ? 1 : (size_t)(separator - path);
+        char *dir = btk_arena_alloc(arena, dir_len + 1);
+        memcpy(dir, path, dir_len);
+        dir[dir_len] = 0;
+        dirpath = dir;
+    }
+    btkfs_watch_t watch;
+    if(btkfs_watch_open(&watch) != 0 || btkfs_watch_add(&watch, dirpath) != 0) {
+        fprintf(stderr, "WARNING: Couldn't watch %s, %s is checked every %d ms instead\n", dirpath, path, FOLLOW_POLL_INTERVAL_MS);
+        btkfs_watch_close(&watch);
+    }
+    int timeout_ms = watch.fd >= 0 ? FOLLOW_RESCAN_INTERVAL_MS : FOLLOW_POLL_INTERVAL_MS;
+    int exit_code = 0;
+    for(;;) {
+        ng_search_follower(searcher, follower);
+        writer_flush(writer);
+        if(fflush(stdout) != 0 || ferror(stdout)) break;
+        if(btkfs_watch_wait(&watch, timeout_ms) < 0) {
+            fprintf(stderr, "ERROR: Couldn't wait for %s to change\n", path);
+            exit_code = EXIT_FAILURE;
+            break;
+        }
+    }
+    btkfs_watch_close(&watch);
+    ng_follower_free(follower);
+    return exit_code;
 }
 
 int main(int argc, const char **argv)
 {
-    SearchContext sc;
-    char buf[1024];
+    btk_arena_t in_life = {0};
     btk_stringview_t pattern = BTK_SV_NULL;
     btk_stringview_t dir = BTK_SV_NULL;
 
+    ng_search_options_t search_options = ng_search_default_options();
+    search_options.thread_count = btk_thread_hardware_concurrency();
+    ng_pattern_options_t pattern_options = ng_pattern_default_options();
+    OutputFormat output_format = OUTPUT_TEXT;
+    const char *files_from = NULL;
+    char files_from_delimiter = '\n';
+    bool show_stats = false;
+    const char *cache_path = NULL;
+    uint64_t cache_size = DEFAULT_CACHE_SIZE;
+    const char *bloom_path = NULL;
+    const char *bloom_build_path = NULL;
+    double bloom_false_positive_rate = DEFAULT_BLOOM_FALSE_POSITIVE_RATE;
+    const char *suffix_array_path = NULL;
+    const char *suffix_array_build_path = NULL;
+    const char *lines_index_build_path = NULL;
+    uint64_t lines_interval = DEFAULT_LINES_INTERVAL;
+    bool lines_range = false;
+    bool follow = false;
+
     Args args;
     args.count = argc;
     args.items = argv;
     shift_args(&args, "Unreachable");
 
-    pattern = shift_args(&args, "Provide the pattern that should be searched");
+    bool only_positional = false;
+    while(args.count > 0) {
+        btk_stringview_t arg = shift_args(&args, "Unreachable");
+        if(only_positional || arg.count < 2 || arg.data[0] != '-') {
+            if(pattern.data == NULL) pattern = arg;
+            else if(dir.data == NULL) dir = arg;
+            else args_error("Too many positional arguments");
+        } else if(btk_sv_eq(arg, BTK_SV("--"))) {
+            only_positional = true;
+        } else if(btk_sv_eq(arg, BTK_SV("-j")) || btk_sv_eq(arg, BTK_SV("--threads"))) {
+            search_options.thread_count = (int)parse_number_arg(shift_args(&args, "Provide the number of threads"), "Invalid number of threads");
+        } else if(btk_sv_eq(arg, BTK_SV("-w")) || btk_sv_eq(arg, BTK_SV("--word-regexp"))) {
+            pattern_options.whole_word = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("-x")) || btk_sv_eq(arg, BTK_SV("--line-regexp"))) {
+            pattern_options.whole_line = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("-v")) || btk_sv_eq(arg, BTK_SV("--invert-match"))) {
+            search_options.invert_match = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("--glob"))) {
+            pattern_options.glob = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("--jit"))) {
+            pattern_options.jit = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("--fuzzy"))) {
+            pattern_options.max_errors = (size_t)parse_number_arg(shift_args(&args, "Provide the number of errors"), "Invalid number of errors");
+        } else if(btk_sv_eq(arg, BTK_SV("--hex")) || btk_sv_eq(arg, BTK_SV("--bytes"))) {
+            pattern_options.bytes_mode = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("-A")) || btk_sv_eq(arg, BTK_SV("--after-context"))) {
+            search_options.after_context = (size_t)parse_number_arg(shift_args(&args, "Provide the number of lines"), "Invalid number of lines");
+        } else if(btk_sv_eq(arg, BTK_SV("-B")) || btk_sv_eq(arg, BTK_SV("--before-context"))) {
+            search_options.before_context = (size_t)parse_number_arg(shift_args(&args, "Provide the number of lines"), "Invalid number of lines");
+        } else if(btk_sv_eq(arg, BTK_SV("-C")) || btk_sv_eq(arg, BTK_SV("--context"))) {
+            search_options.before_context = (size_t)parse_number_arg(shift_args(&args, "Provide the number of lines"), "Invalid number of lines");
+            search_options.after_context = search_options.before_context;
+        } else if(btk_sv_eq(arg, BTK_SV("--json"))) {
+            output_format = OUTPUT_JSON;
+        } else if(btk_sv_eq(arg, BTK_SV("--binary-out"))) {
+            output_format = OUTPUT_BINARY;
+        } else if(btk_sv_eq(arg, BTK_SV("--files-from"))) {
+            files_from = shift_args(&args, "Provide the file that lists the paths").data;
+        } else if(arg.count > 13 && btk_sv_eq(btk_sv_slice(arg, 0, 13), BTK_SV("--files-from="))) {
+            files_from = arg.data + 13;
+        } else if(btk_sv_eq(arg, BTK_SV("-0")) || btk_sv_eq(arg, BTK_SV("--null"))) {
+            files_from_delimiter = 0;
+        } else if(btk_sv_eq(arg, BTK_SV("--prefetch"))) {
+            search_options.prefetch_depth = (int)parse_number_arg(shift_args(&args, "Provide the prefetch depth"), "Invalid prefetch depth");
+        } else if(btk_sv_eq(arg, BTK_SV("--drop-cache-threshold"))) {
+            search_options.drop_cache_threshold = parse_number_arg(shift_args(&args, "Provide the drop cache threshold"), "Invalid drop cache threshold");
+        } else if(btk_sv_eq(arg, BTK_SV("--stats"))) {
+            show_stats = true;
+            search_options.collect_stats = 1;
+        } else if(btk_sv_eq(arg, BTK_SV("--cache"))) {
+            cache_path = shift_args(&args, "Provide the cache file").data;
+        } else if(btk_sv_eq(arg, BTK_SV("--cache-size"))) {
+            cache_size = parse_number_arg(shift_args(&args, "Provide the size of the cache"), "Invalid size of the cache");
+        } else if(btk_sv_eq(arg, BTK_SV("--bloom"))) {
+            bloom_path = shift_args(&args, "Provide the Bloom filter file").data;
+        } else if(btk_sv_eq(arg, BTK_SV("--bloom-build"))) {
+            bloom_build_path = shift_args(&args, "Provide the Bloom filter file to write").data;
+        } else if(btk_sv_eq(arg, BTK_SV("--bloom-fp"))) {
+            bloom_false_positive_rate = parse_rate_arg(shift_args(&args, "Provide the false positive rate"), "Invalid false positive rate, it should be between 0 and 1");
+        } else if(btk_sv_eq(arg, BTK_SV("--suffix-array"))) {
+            suffix_array_path = shift_args(&args, "Provide the suffix array index").data;
+        } else if(btk_sv_eq(arg, BTK_SV("--suffix-array-build"))) {
+            suffix_array_build_path = shift_args(&args, "Provide the suffix array index to write").data;
+        } else if(btk_sv_eq(arg, BTK_SV("--follow"))) {
+            follow = true;
+        } else if(btk_sv_eq(arg, BTK_SV("--lines"))) {
+            parse_lines_arg(shift_args(&args, "Provide the range of rows"), &search_options.first_row, &search_options.row_count);
+            lines_range = true;
+        } else if(btk_sv_eq(arg, BTK_SV("--lines-index-build"))) {
+            lines_index_build_path = shift_args(&args, "Provide the file to index the lines of").data;
+        } else if(btk_sv_eq(arg, BTK_SV("--lines-interval"))) {
+            lines_interval = parse_number_arg(shift_args(&args, "Provide the number of rows"), "Invalid number of rows");
+            if(lines_interval == 0 || lines_interval > UINT32_MAX) args_error("Invalid number of rows");
+        } else if(btk_sv_eq(arg, BTK_SV("--chunk-threshold"))) {
+            search_options.chunk_threshold = parse_number_arg(shift_args(&args, "Provide the chunked scanning threshold"), "Invalid chunked scanning threshold");
+        } else {
+            fprintf(stderr, "ERROR: Unknown option "BTK_SV_FMT"\n", BTK_SV_ARGV(arg));
+            usage("grepper");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(lines_index_build_path != NULL) {
+        if(pattern.data != NULL) args_error("--lines-index-build only takes the file to index");
+        int res = ng_line_index_write(lines_index_build_path, (uint32_t)lines_interval);
+        if(res != NG_OK) fprintf(stderr, "ERROR: Couldn't index the lines of %s: %s\n", lines_index_build_path, ng_explain(res));
+        btk_arena_free(&in_life);
+        return res == NG_OK ? 0 : EXIT_FAILURE;
+    }
+    // There's no pattern when an index is built, the only positional argument is the path
+    if(bloom_build_path != NULL || suffix_array_build_path != NULL) {
+        if(dir.data != NULL) args_error("Building an index only takes the path to index");
+        if(bloom_build_path != NULL && suffix_array_build_path != NULL) args_error("Build one index at a time");
+        const char *path = pattern.data;
+        if(path == NULL) {
+            int res = btkfs_getcwd(NULL, 0);
+            assert(res >= 0);
+            char *cwd = btk_arena_alloc(&in_life, sizeof(char)*res);
+            assert(btkfs_getcwd(cwd, res) >= 0);
+            path = cwd;
+        }
+        int exit_code = bloom_build_path != NULL ? build_bloom_sidecar(bloom_build_path, path, bloom_false_positive_rate)
+            : build_suffix_array_index(suffix_array_build_path, path);
+        btk_arena_free(&in_life);
+        return exit_code;
+    }
+    if(pattern.count == 0) args_error("Provide the pattern that should be searched");
+    if(files_from != NULL && dir.data != NULL) args_error("The paths are already given by --files-from");
+    if(search_options.invert_match && pattern_options.bytes_mode) args_error("-v can't be used with a hex pattern");
+    if(pattern_options.max_errors > 0 && pattern_options.bytes_mode) args_error("--fuzzy can't be used with a hex pattern");
+    if(pattern_options.glob && (pattern_options.bytes_mode || pattern_options.max_errors > 0)) {
+        args_error("--glob can't be used with a hex pattern or --fuzzy");
+    }
+    if(pattern_options.max_errors > 0 && pattern_options.max_errors >= pattern.count) {
+        args_error("--fuzzy must be less than the length of the pattern");
+    }
+    if(search_options.invert_match && (search_options.before_context > 0 || search_options.after_context > 0)) {
+        args_error("-v can't be used with context lines");
+    }
+    if(lines_range && (search_options.invert_match || search_options.before_context > 0 || search_options.after_context > 0)) {
+        args_error("--lines can't be used with -v or context lines");
+    }
+    if(lines_range && (pattern_options.bytes_mode || suffix_array_path != NULL)) {
+        args_error("--lines can't be used with a hex pattern or --suffix-array");
+    }
+    if(follow) {
+        if(dir.data == NULL || btk_sv_eq(dir, BTK_SV("-")) || files_from != NULL || suffix_array_path != NULL || btkfs_isdir(dir.data)) {
+            args_error("--follow needs the path of a file");
+        }
+        if(search_options.invert_match || search_options.before_context > 0 || search_options.after_context > 0 || pattern_options.bytes_mode) {
+            args_error("--follow can't be used with -v, context lines or a hex pattern");
+        }
+    }
+    if(suffix_array_path != NULL) {
+        if(dir.data != NULL || files_from != NULL) args_error("The files of --suffix-array are in the index");
+        if(pattern_options.bytes_mode || pattern_options.max_errors > 0 || pattern_options.glob) {
+            args_error("--suffix-array only searches a plain pattern");
+        }
+        if(search_options.invert_match || search_options.before_context > 0 || search_options.after_context > 0) {
+            args_error("--suffix-array can't be used with -v or context lines");
+        }
+    }
 
+    ng_pattern_t *compiled;
+    int compile_result = ng_pattern_compile(&compiled, pattern.data, pattern.count, &pattern_options);
+    if(compile_result == NG_ERROR_INVALID_ARGUMENTS && pattern_options.max_errors > 0) {
+        args_error("The pattern of --fuzzy is too long");
+    } else if(compile_result == NG_ERROR_INVALID_ARGUMENTS) {
+        args_error("-w and -x can't be used with a hex pattern");
+    } else if(compile_result != NG_OK && pattern_options.glob) {
+        args_error("Invalid glob, it needs a byte that's not '*', at most 64 of them, and every '[' closed");
+    } else if(compile_result != NG_OK) {
+        args_error("Invalid hex pattern, it should be hex digits or '?' i.e. \"DE ?? BE EF\"");
+    }
 
-    sc_init(&sc, pattern);
-    sc.readbuf = buf;
-    sc.readbufsz = 1024;
+    // The search goes on without it, the cache only makes it faster
+    ng_cache_t *cache = NULL;
+    if(cache_path != NULL && ng_cache_open(&cache, cache_path, cache_size) != NG_OK) {
+        fprintf(stderr, "WARNING: Couldn't open the cache %s, it's searched without it\n", cache_path);
+        cache = NULL;
+    }
+    search_options.cache = cache;
+    ng_bloom_t *bloom = NULL;
+    if(bloom_path != NULL && ng_bloom_open(&bloom, bloom_path) != NG_OK) {
+        fprintf(stderr, "WARNING: Couldn't open the Bloom filters %s, every file is searched\n", bloom_path);
+        bloom = NULL;
+    }
+    search_options.bloom = bloom;
 
-    if(args.count > 0) {
-        dir = shift_args(&args, "Unreachable");
-    } else {
-        int res = btkfs_getcwd(NULL, 0);
-        assert(res >= 0);
-        char *dir1 = btk_arena_alloc(&sc.in_life, sizeof(char)*res);
-        assert(btkfs_getcwd(dir1, res) >= 0);
+    Writer writer;
+    writer_init(&writer, stdout, btk_arena_alloc(&in_life, WRITER_CAPACITY), WRITER_CAPACITY);
+    Printer printer = {
+        .writer = &writer,
+        .format = output_format,
+        .bytes_mode = pattern_options.bytes_mode != 0,
+        .arena = &in_life,
+        .with_context = search_options.before_context > 0 || search_options.after_context > 0,
+        .line_buffered = is_terminal(stdout),
+    };
+    if(output_format == OUTPUT_BINARY) writer_write(&writer, BINARY_OUT_MAGIC, 4);
 
-        // This will safe since we allocate it for the life time of search context
-        dir = btk_sv_from_cstr(dir1);
+    if(files_from != NULL) {
+        writer_flush(&writer);
+        ng_stats_t stats = {0};
+        uint64_t match_count = search_files_from(files_from, files_from_delimiter, compiled, search_options,
+                &printer, search_options.thread_count, &stats);
+        if(match_count == 0 && output_format == OUTPUT_TEXT) writer_write_literal(&writer, "Nothing found!\n");
+        writer_flush(&writer);
+        if(show_stats) print_stats(stats);
+        ng_cache_close(cache);
+        ng_bloom_close(bloom);
+        ng_pattern_free(compiled);
+        btk_arena_free(&in_life);
+        return 0;
     }
 
-    search_in_dir(&sc, dir);
+    ng_searcher_t *searcher = ng_searcher_new(compiled, &search_options, print_record, &printer);
+    assert(searcher && "Failed to create the searcher");
 
-    if(sc.results.count == 0) {
-        printf("Nothing found!\n");
-        return 0;
+    if(suffix_array_path != NULL) {
+        ng_suffix_array_t *index;
+        int res = ng_suffix_array_open(&index, suffix_array_path);
+        if(res != NG_OK) {
+            fprintf(stderr, "ERROR: Couldn't open the suffix array index %s: %s\n", suffix_array_path, ng_explain(res));
+            exit(EXIT_FAILURE);
+        }
+        ng_search_suffix_array(searcher, index);
+        ng_suffix_array_close(index);
+    } else if(follow) {
+        int exit_code = follow_file(searcher, dir.data, &writer, &in_life);
+        if(show_stats) print_stats(ng_searcher_stats(searcher));
+        ng_searcher_free(searcher);
+        ng_cache_close(cache);
+        ng_bloom_close(bloom);
+        ng_pattern_free(compiled);
+        btk_arena_free(&in_life);
+        return exit_code;
+    } else if(btk_sv_eq(dir, BTK_SV("-")) || (dir.data == NULL && stdin_has_data())) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        ng_search_stream(searcher, "(standard input)", read_some, stdin);
+    } else if(dir.data == NULL) {
+        int res = btkfs_getcwd(NULL, 0);
+        assert(res >= 0);
+        char *dir1 = btk_arena_alloc(&in_life, sizeof(char)*res);
+        assert(btkfs_getcwd(dir1, res) >= 0);
+        ng_search_dir(searcher, dir1);
+    } else if(btkfs_isdir(dir.data)) {
+        ng_search_dir(searcher, dir.data);
+    } else {
+        ng_search_file(searcher, dir.data);
     }
 
-    for(size_t i = 0; i < sc.results.count; ++i) {
-        show_result(sc.results.items[i]);
+    if(ng_searcher_match_count(searcher) == 0 && output_format == OUTPUT_TEXT) {
+        writer_write_literal(&writer, "Nothing found!\n");
     }
-    sc_destroy(&sc);
+    writer_flush(&writer);
+    if(show_stats) print_stats(ng_searcher_stats(searcher));
+    ng_searcher_free(searcher);
+    ng_cache_close(cache);
+    ng_bloom_close(bloom);
+    ng_pattern_free(compiled);
+    btk_arena_free(&in_life);
     return 0;
 }
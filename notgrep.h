@@ -0,0 +1,308 @@
+/*
+
+   `notgrep.h` - libnotgrep, the search engine of notgrep as an embeddable C library
+
+    Guide:
+    1. Compile the pattern once, it's immutable so it could be shared by searchers in multiple threads
+    ```c
+     ng_pattern_t *pattern;
+     if(ng_pattern_compile(&pattern, "ERROR", 5, NULL) != NG_OK) ...;
+    ```
+
+    2. Create a searcher for each thread. Matches are delivered to the callback as they are found
+    ```c
+     int on_match(void *user, const ng_match_t *match)
+     {
+         printf("%.*s:%llu\n", (int)match->path_len, match->path, (unsigned long long)match->row);
+         return 0; // Non zero stops the search
+     }
+
+     ng_searcher_t *searcher = ng_searcher_new(pattern, NULL, on_match, NULL);
+     ng_search_dir(searcher, "/var/log");
+     ng_searcher_free(searcher);
+     ng_pattern_free(pattern);
+    ```
+
+    3. Link with libnotgrep.a (-lpthread on Linux) or libnotgrep.so
+
+*/
+#ifndef NOTGREP_H_
+#define NOTGREP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifdef NOTGREP_SHARED
+#define NGAPI __declspec(dllexport)
+#else
+#define NGAPI
+#endif
+#elif defined(__GNUC__)
+#define NGAPI __attribute__((visibility("default")))
+#else
+#define NGAPI
+#endif
+
+enum ng_error_codes {
+    NG_OK = 0,
+    NG_ERROR_UNKNOWN = -1,
+    NG_ERROR_INVALID_ARGUMENTS = -2,
+    NG_ERROR_INVALID_PATTERN = -3,
+    NG_ERROR_COULDNT_OPEN = -4,
+    NG_ERROR_STOPPED = -5,
+};
+
+typedef struct ng_pattern ng_pattern_t;
+typedef struct ng_searcher ng_searcher_t;
+typedef struct ng_cache ng_cache_t;
+typedef struct ng_bloom ng_bloom_t;
+typedef struct ng_bloom_builder ng_bloom_builder_t;
+typedef struct ng_suffix_array ng_suffix_array_t;
+typedef struct ng_suffix_array_builder ng_suffix_array_builder_t;
+typedef struct ng_follower ng_follower_t;
+
+typedef struct ng_pattern_options {
+    // The pattern is hex bytes with '?' as a wildcard nibble i.e. "DE ?? BE EF". Matches only have byte offsets
+    int bytes_mode;
+    // Only matches that are not part of a bigger word (letters, digits and '_'), like `grep -w`
+    int whole_word;
+    // Only matches that are the whole line, like `grep -x`. It wins over `whole_word`
+    int whole_line;
+    // Also match text that's at most this many insertions, deletions or substitutions away from the pattern. It must
+    // be less than the length of the pattern, which is at most 4096 bytes then. 0 is the exact search
+    size_t max_errors;
+    // The pattern is a glob matched inside a line: '?' is any byte, '[a-z]' and '[!a-z]' are sets of bytes, '*' is
+    // any run of bytes and '\' escapes. A match is the one that ends first. It can have at most 64 bytes besides '*'
+    int glob;
+    // Compile the glob to machine code instead of walking its state table. It's only on x86-64 (not Windows), the
+    // table is used on the others or if there's no executable memory
+    int jit;
+} ng_pattern_options_t;
+
+typedef struct ng_search_options {
+    // Threads used to scan a single file that's at least `chunk_threshold` bytes
+    int thread_count;
+    uint64_t chunk_threshold;
+    // Context lines delivered around each match
+    size_t before_context;
+    size_t after_context;
+    // How many of the next files of a directory are read into the page cache in the background while
+    // the current one is searched. 0 disables it, it's the default
+    int prefetch_depth;
+    // Files at least this big are dropped from the page cache after they're searched, so a one off search
+    // doesn't push out what's already cached. 0 disables it
+    uint64_t drop_cache_threshold;
+    // Check if the prefetched files are already in the page cache when they're searched, see ng_stats_t
+    int collect_stats;
+    // Deliver the lines without a match as NG_RECORD_LINES instead of the matches, like `grep -v`. The context
+    // lines are ignored with it and it's ignored with a byte pattern
+    int invert_match;
+    // Serve the unchanged files from this result cache and store the results of the others in it. It's not used
+    // with `invert_match` or context lines. See ng_cache_open()
+    ng_cache_t *cache;
+    // Skip the files that surely have no match by their Bloom filters in this sidecar without opening them. It's
+    // not used with `invert_match` or a pattern without 3 bytes that every match has. See ng_bloom_open()
+    const ng_bloom_t *bloom;
+    // Only deliver the matches in `row_count` rows from `first_row` (0 is to the end of the file). A plain file is
+    // read from the first row, found from its `.nglines` sidecar if it has one (see ng_line_index_write()). It's not
+    // used with `invert_match`, context lines or a byte pattern
+    uint64_t first_row;
+    uint64_t row_count;
+} ng_search_options_t;
+
+typedef enum ng_record_kind {
+    NG_RECORD_MATCH = 0,
+    NG_RECORD_CONTEXT,       // A line around a match, only `row`, `offset` and `preview` are set
+    NG_RECORD_CONTEXT_BREAK, // Separates context groups that are not next to each other
+    NG_RECORD_LINES,         // Whole lines without a match, `row` is the first one and `preview` is all of their bytes
+} ng_record_kind_t;
+
+/**
+ * All of the pointers are only valid during the callback
+ */
+typedef struct ng_match {
+    ng_record_kind_t kind;
+    const char *path;
+    size_t path_len;
+    uint64_t row;
+    // In characters if the line up to the match is valid UTF-8, in bytes otherwise or if the line is too long
+    // to be kept as a whole
+    uint64_t col;
+    uint64_t offset;         // Byte offset of the match from the start of the file
+    uint64_t line_offset;    // Byte offset of the line containing the match
+    size_t len;              // Length of the match in bytes
+    uint64_t preview_offset; // Byte offset of the preview, it's only a part of the line if the line is too long
+    const char *preview;
+    size_t preview_len;
+} ng_match_t;
+
+typedef struct ng_stats {
+    uint64_t files;
+    uint64_t bytes;
+    uint64_t prefetched;
+    // Prefetched files that are already in the page cache when they're searched, only with `collect_stats`
+    uint64_t prefetch_hits;
+    uint64_t dropped;
+    // Files served from the result cache, they're not counted in `files` and `bytes`
+    uint64_t cache_hits;
+    // Files skipped by their Bloom filters, they're not counted in `files` and `bytes`
+    uint64_t bloom_skipped;
+} ng_stats_t;
+
+/**
+ * Called for every match (and context line). Returning non zero stops the search
+ */
+typedef int (*ng_match_fn)(void *user, const ng_match_t *match);
+
+/**
+ * Read at most `bufsz` bytes into `buf`. Returning 0 means the end of the stream
+ */
+typedef size_t (*ng_read_fn)(void *user, char *buf, size_t bufsz);
+
+NGAPI ng_pattern_options_t ng_pattern_default_options(void);
+NGAPI ng_search_options_t ng_search_default_options(void);
+
+/**
+ * Compile a pattern. `options` could be NULL for the default options
+ *
+ * This function returns int which
+ * ng_pattern_compile(...) <  0 if it's an error
+ * ng_pattern_compile(...) == 0 if it's success
+ */
+NGAPI int ng_pattern_compile(ng_pattern_t **pattern, const char *text, size_t text_len, const ng_pattern_options_t *options);
+NGAPI void ng_pattern_free(ng_pattern_t *pattern);
+
+/**
+ * A searcher holds the buffers of a search so it must only be used by one thread at a time. The pattern
+ * must outlive the searcher. `options` could be NULL for the default options
+ */
+NGAPI ng_searcher_t *ng_searcher_new(const ng_pattern_t *pattern, const ng_search_options_t *options, ng_match_fn on_match, void *user);
+NGAPI void ng_searcher_free(ng_searcher_t *searcher);
+
+/**
+ * These functions return int which
+ * ng_search_xxx(...) <  0 if it's an error or NG_ERROR_STOPPED if the callback stopped the search
+ * ng_search_xxx(...) == 0 if it's success
+ */
+NGAPI int ng_search_buffer(ng_searcher_t *searcher, const char *name, const char *data, size_t size);
+NGAPI int ng_search_file(ng_searcher_t *searcher, const char *filepath);
+NGAPI int ng_search_dir(ng_searcher_t *searcher, const char *dirpath);
+
+/**
+ * Search data coming from `read_fn` i.e. a pipe. It's searched as it comes, except with context lines or
+ * a byte pattern which need the whole stream in memory. `name` is the path of the matches
+ */
+NGAPI int ng_search_stream(ng_searcher_t *searcher, const char *name, ng_read_fn read_fn, void *user);
+
+/**
+ * Start reading a file that's going to be searched soon into the page cache in the background. The directory
+ * search does it by itself for the next `prefetch_depth` files
+ */
+NGAPI void ng_prefetch_file(ng_searcher_t *searcher, const char *filepath);
+
+/**
+ * Open a result cache, it's created if it doesn't exist. It's a file of `max_size` bytes that remembers, for each
+ * pattern and file, if the file has no match or where its matches are. A file is served from it while its inode,
+ * size and modification time are the same, and the least recently used files are dropped when it's full. It could
+ * be shared by the searchers of multiple threads but only one process could have it open, it's locked.
+ * It's only supported on POSIX for now
+ *
+ * This function returns int which
+ * ng_cache_open(...) <  0 if it's an error
+ * ng_cache_open(...) == 0 if it's success
+ */
+NGAPI int ng_cache_open(ng_cache_t **cache, const char *path, uint64_t max_size);
+NGAPI void ng_cache_close(ng_cache_t *cache);
+
+/**
+ * A Bloom filter sidecar has a filter of the 3 byte grams of every file added to it, made for the given false
+ * positive rate and at most as big as the file. A file is known by its inode, and its filter is only used while its
+ * size and modification time are the same, so a changed file is searched until it's added to a new sidecar.
+ * Compressed and UTF-16 files are always searched. Getting the inode is only supported on POSIX for now
+ */
+NGAPI ng_bloom_builder_t *ng_bloom_builder_new(double false_positive_rate);
+NGAPI void ng_bloom_builder_free(ng_bloom_builder_t *builder);
+
+/**
+ * These functions return int which
+ * ng_bloom_xxx(...) <  0 if it's an error
+ * ng_bloom_xxx(...) == 0 if it's success
+ */
+NGAPI int ng_bloom_add_file(ng_bloom_builder_t *builder, const char *filepath);
+NGAPI int ng_bloom_add_dir(ng_bloom_builder_t *builder, const char *dirpath);
+NGAPI int ng_bloom_write(ng_bloom_builder_t *builder, const char *path);
+NGAPI int ng_bloom_open(ng_bloom_t **bloom, const char *path);
+NGAPI void ng_bloom_close(ng_bloom_t *bloom);
+
+/**
+ * A suffix array index of a frozen corpus: the files are concatenated and every suffix of it is sorted (SA-IS, in
+ * linear time). A search of it is two binary searches of the pattern, the matches are put back on their files and rows
+ * from the index alone without reading the files. It's 9 times as big as the corpus plus 8 bytes per line, the text
+ * and the suffix array are made in a mapping of the index file. The files are read when it's written
+ */
+NGAPI ng_suffix_array_builder_t *ng_suffix_array_builder_new(void);
+NGAPI void ng_suffix_array_builder_free(ng_suffix_array_builder_t *builder);
+
+/**
+ * These functions return int which
+ * ng_suffix_array_xxx(...) <  0 if it's an error
+ * ng_suffix_array_xxx(...) == 0 if it's success
+ */
+NGAPI int ng_suffix_array_add_file(ng_suffix_array_builder_t *builder, const char *filepath);
+NGAPI int ng_suffix_array_add_dir(ng_suffix_array_builder_t *builder, const char *dirpath);
+NGAPI int ng_suffix_array_write(ng_suffix_array_builder_t *builder, const char *path);
+NGAPI int ng_suffix_array_open(ng_suffix_array_t **index, const char *path);
+NGAPI void ng_suffix_array_close(ng_suffix_array_t *index);
+
+/**
+ * Deliver the matches of a plain pattern (not hex, --fuzzy or --glob) in the index, in the order of the files. -w
+ * and -x are supported, the search options besides them are not used
+ *
+ * This function returns int which
+ * ng_search_suffix_array(...) <  0 if it's an error or NG_ERROR_STOPPED if the callback stopped the search
+ * ng_search_suffix_array(...) == 0 if it's success
+ */
+NGAPI int ng_search_suffix_array(ng_searcher_t *searcher, const ng_suffix_array_t *index);
+
+/**
+ * Write the `.nglines` sidecar of a file next to it (`filepath` + ".nglines"), it has the offset of every
+ * `interval`-th row so a row is found by counting the newlines from the one before it. It's for append-only files
+ * like logs: it's used while the file is the same inode and isn't smaller, and writing it again only reads what's
+ * appended since. Getting the inode is only supported on POSIX for now
+ *
+ * This function returns int which
+ * ng_line_index_write(...) <  0 if it's an error
+ * ng_line_index_write(...) == 0 if it's success
+ */
+NGAPI int ng_line_index_write(const char *filepath, uint32_t interval);
+
+/**
+ * A follower remembers how far a growing file (i.e. a log) is searched. Every ng_search_follower() only reads what's
+ * appended since the last one, and a last line without its newline yet waits for it. A file that's truncated is searched
+ * from its start again, and when another file is at the path (it's rotated) the rest of the old file is searched
+ * before the new one. A file that doesn't exist yet is fine, nothing is searched until it's there.
+ * The file is searched as plain bytes: it's not decompressed or transcoded
+ */
+NGAPI ng_follower_t *ng_follower_new(const char *filepath);
+NGAPI void ng_follower_free(ng_follower_t *follower);
+
+/**
+ * The searcher can't have a byte pattern, `invert_match` or context lines. A stopped search goes on after the lines
+ * that are already searched
+ *
+ * This function returns int which
+ * ng_search_follower(...) <  0 if it's an error or NG_ERROR_STOPPED if the callback stopped the search
+ * ng_search_follower(...) == 0 if it's success
+ */
+NGAPI int ng_search_follower(ng_searcher_t *searcher, ng_follower_t *follower);
+
+/**
+ * How many matches are found by the searcher so far
+ */
+NGAPI uint64_t ng_searcher_match_count(const ng_searcher_t *searcher);
+NGAPI ng_stats_t ng_searcher_stats(const ng_searcher_t *searcher);
+
+NGAPI const char *ng_explain(int error_code);
+
+#endif // NOTGREP_H_